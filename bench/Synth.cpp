@@ -0,0 +1,186 @@
+/*
+ * Copyright (C) 2026 v0lt
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include <cmath>
+#include <format>
+#include "Synth.h"
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libavutil/channel_layout.h>
+}
+
+static int encode_write(AVFormatContext* oc, AVCodecContext* enc, AVStream* st, const AVFrame* frame, AVPacket* pkt)
+{
+	int ret = avcodec_send_frame(enc, frame);
+	while (ret >= 0) {
+		ret = avcodec_receive_packet(enc, pkt);
+		if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
+			return 0;
+		}
+		if (ret < 0) {
+			break;
+		}
+		av_packet_rescale_ts(pkt, enc->time_base, st->time_base);
+		pkt->stream_index = st->index;
+		ret = av_interleaved_write_frame(oc, pkt);
+	}
+	return ret;
+}
+
+static void fill_video(AVFrame* frame, const int n)
+{
+	// diagonal bars moving by 4 pixels per frame, chroma changes slowly
+	for (int y = 0; y < frame->height; y++) {
+		uint8_t* p = frame->data[0] + y * frame->linesize[0];
+		for (int x = 0; x < frame->width; x++) {
+			p[x] = uint8_t((x + y + n * 4) & 0xFF);
+		}
+	}
+	for (int y = 0; y < frame->height / 2; y++) {
+		uint8_t* u = frame->data[1] + y * frame->linesize[1];
+		uint8_t* v = frame->data[2] + y * frame->linesize[2];
+		for (int x = 0; x < frame->width / 2; x++) {
+			u[x] = uint8_t(128 + y + n);
+			v[x] = uint8_t(64 + x + n * 2);
+		}
+	}
+}
+
+static void fill_audio(AVFrame* frame, const int64_t first_sample)
+{
+	int16_t* p = (int16_t*)frame->data[0];
+	const int channels = frame->ch_layout.nb_channels;
+	for (int i = 0; i < frame->nb_samples; i++) {
+		const double t = double(first_sample + i) / frame->sample_rate;
+		const int16_t v = int16_t(8000 * std::sin(2 * 3.14159265358979 * 440 * t));
+		for (int c = 0; c < channels; c++) {
+			*p++ = v;
+		}
+	}
+}
+
+bool WriteSynthMedia(const std::string& path, const SynthParams& params, std::string& error)
+{
+	AVFormatContext* oc = nullptr;
+	AVCodecContext* venc = nullptr;
+	AVCodecContext* aenc = nullptr;
+	AVFrame* vframe = av_frame_alloc();
+	AVFrame* aframe = av_frame_alloc();
+	AVPacket* pkt = av_packet_alloc();
+	AVStream* vst = nullptr;
+	AVStream* ast = nullptr;
+	const AVCodec* vcodec = avcodec_find_encoder(AV_CODEC_ID_MPEG4);
+	const AVCodec* acodec = avcodec_find_encoder(AV_CODEC_ID_PCM_S16LE);
+	const int audio_frame = params.sample_rate / params.fps;
+	bool ok = false;
+	int ret;
+
+	if (!vcodec || !acodec) {
+		error = "required encoders are not available";
+		goto end;
+	}
+	ret = avformat_alloc_output_context2(&oc, nullptr, "matroska", path.c_str());
+	if (ret < 0) {
+		error = "unable to create the output context";
+		goto end;
+	}
+
+	vst = avformat_new_stream(oc, nullptr);
+	venc = avcodec_alloc_context3(vcodec);
+	venc->width        = params.width;
+	venc->height       = params.height;
+	venc->pix_fmt      = AV_PIX_FMT_YUV420P;
+	venc->time_base    = { 1, params.fps };
+	venc->framerate    = { params.fps, 1 };
+	venc->gop_size     = params.gop;
+	venc->max_b_frames = params.gop > 1 ? params.bframes : 0;
+	venc->bit_rate     = int64_t(params.width) * params.height * params.fps / 10;
+	if (oc->oformat->flags & AVFMT_GLOBALHEADER) {
+		venc->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+	}
+	ret = avcodec_open2(venc, vcodec, nullptr);
+	if (ret < 0) {
+		error = "unable to open the video encoder";
+		goto end;
+	}
+	avcodec_parameters_from_context(vst->codecpar, venc);
+	vst->time_base = venc->time_base;
+
+	ast = avformat_new_stream(oc, nullptr);
+	aenc = avcodec_alloc_context3(acodec);
+	aenc->sample_fmt  = AV_SAMPLE_FMT_S16;
+	aenc->sample_rate = params.sample_rate;
+	aenc->time_base   = { 1, params.sample_rate };
+	av_channel_layout_default(&aenc->ch_layout, params.channels);
+	ret = avcodec_open2(aenc, acodec, nullptr);
+	if (ret < 0) {
+		error = "unable to open the audio encoder";
+		goto end;
+	}
+	avcodec_parameters_from_context(ast->codecpar, aenc);
+	ast->time_base = aenc->time_base;
+
+	ret = avio_open(&oc->pb, path.c_str(), AVIO_FLAG_WRITE);
+	if (ret < 0) {
+		error = std::format("unable to create {}", path);
+		goto end;
+	}
+	ret = avformat_write_header(oc, nullptr);
+	if (ret < 0) {
+		error = "unable to write the header";
+		goto end;
+	}
+
+	vframe->format = venc->pix_fmt;
+	vframe->width  = venc->width;
+	vframe->height = venc->height;
+	av_frame_get_buffer(vframe, 0);
+
+	aframe->format      = aenc->sample_fmt;
+	aframe->sample_rate = aenc->sample_rate;
+	aframe->nb_samples  = audio_frame;
+	av_channel_layout_copy(&aframe->ch_layout, &aenc->ch_layout);
+	av_frame_get_buffer(aframe, 0);
+
+	for (int i = 0; i < params.frames; i++) {
+		av_frame_make_writable(vframe);
+		fill_video(vframe, i);
+		vframe->pts = i;
+		ret = encode_write(oc, venc, vst, vframe, pkt);
+		if (ret < 0) {
+			error = "video encoding failed";
+			goto end;
+		}
+
+		av_frame_make_writable(aframe);
+		fill_audio(aframe, int64_t(i) * audio_frame);
+		aframe->pts = int64_t(i) * audio_frame;
+		ret = encode_write(oc, aenc, ast, aframe, pkt);
+		if (ret < 0) {
+			error = "audio encoding failed";
+			goto end;
+		}
+	}
+	encode_write(oc, venc, vst, nullptr, pkt);
+	encode_write(oc, aenc, ast, nullptr, pkt);
+
+	ok = av_write_trailer(oc) == 0;
+
+end:
+	av_packet_free(&pkt);
+	av_frame_free(&vframe);
+	av_frame_free(&aframe);
+	avcodec_free_context(&venc);
+	avcodec_free_context(&aenc);
+	if (oc) {
+		avio_closep(&oc->pb);
+		avformat_free_context(oc);
+	}
+
+	return ok;
+}
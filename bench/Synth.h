@@ -0,0 +1,24 @@
+/*
+ * Copyright (C) 2026 v0lt
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+
+#include <string>
+
+struct SynthParams {
+	int frames  = 1500;
+	int width   = 1280;
+	int height  = 720;
+	int fps     = 25;
+	int gop     = 50; // 1 makes an intra-only stream
+	int bframes = 2;
+	int sample_rate = 48000;
+	int channels    = 2;
+};
+
+// Writes a Matroska file with a moving test pattern (MPEG-4 Part 2)
+// and a sine tone (PCM), using only encoders built into FFmpeg.
+bool WriteSynthMedia(const std::string& path, const SynthParams& params, std::string& error);
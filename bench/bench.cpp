@@ -0,0 +1,533 @@
+/*
+ * Copyright (C) 2026 v0lt
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// Headless benchmark of the input driver.
+// Loads avlib-1.vdplugin the same way as the host does and replays access patterns
+// on the video and audio sources, reports throughput, latency, decoded frames and memory.
+
+#include <algorithm>
+#include <cstdarg>
+#include <cstdio>
+#include <format>
+#include <random>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <vector>
+
+#include <windows.h>
+#include <psapi.h>
+
+#include <vd2/plugin/vdinputdriver.h>
+#include "../src/PerfCounters.h"
+#include "Synth.h"
+
+#pragma comment(lib, "avcodec")
+#pragma comment(lib, "avformat")
+#pragma comment(lib, "avutil")
+#pragma comment(lib, "psapi")
+
+class BenchCallbacks : public IVDXPluginCallbacks
+{
+public:
+	std::string m_error;
+
+	void* VDXAPIENTRY GetExtendedAPI(const char* pExtendedAPIName) override { return nullptr; }
+
+	void VDXAPIENTRYV SetError(const char* format, ...) override {
+		char buf[1024];
+		va_list args;
+		va_start(args, format);
+		vsnprintf(buf, sizeof(buf), format, args);
+		va_end(args);
+		m_error = buf;
+	}
+
+	void VDXAPIENTRY SetErrorOutOfMemory() override { m_error = "out of memory"; }
+
+	uint32 VDXAPIENTRY GetCPUFeatureFlags() override { return 0; }
+};
+
+struct BenchResult {
+	std::string name;
+	int requests   = 0;
+	double seconds = 0;
+	double p50_ms  = 0;
+	double p99_ms  = 0;
+	int64_t decoded = 0;
+	int64_t seeks   = 0;
+	int errors      = 0;
+	double peak_ws_mb     = 0;
+	double peak_commit_mb = 0;
+};
+
+// Peak memory while one pattern runs. The peak values of the process cover all patterns,
+// so the working set is trimmed before the pattern and sampled on a thread.
+class MemorySampler
+{
+	std::thread m_thread;
+	std::atomic<bool> m_stop = false;
+	SIZE_T m_peakWs     = 0;
+	SIZE_T m_peakCommit = 0;
+
+	void sample()
+	{
+		PROCESS_MEMORY_COUNTERS pmc = { sizeof(pmc) };
+		if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc))) {
+			m_peakWs = std::max(m_peakWs, pmc.WorkingSetSize);
+			m_peakCommit = std::max(m_peakCommit, pmc.PagefileUsage);
+		}
+	}
+
+public:
+	void Start()
+	{
+		EmptyWorkingSet(GetCurrentProcess());
+		m_peakWs = 0;
+		m_peakCommit = 0;
+		m_stop = false;
+		sample();
+		m_thread = std::thread([this] {
+			while (!m_stop) {
+				sample();
+				Sleep(5);
+			}
+		});
+	}
+
+	void Stop(BenchResult& r)
+	{
+		m_stop = true;
+		m_thread.join();
+		sample();
+		const double mb = 1024.0 * 1024.0;
+		r.peak_ws_mb = m_peakWs / mb;
+		r.peak_commit_mb = m_peakCommit / mb;
+	}
+};
+
+static double ticks_to_ms(const int64_t ticks)
+{
+	static const double freq = [] {
+		LARGE_INTEGER f;
+		QueryPerformanceFrequency(&f);
+		return double(f.QuadPart);
+	}();
+	return ticks * 1000.0 / freq;
+}
+
+static void finish_result(BenchResult& r, std::vector<int64_t>& latency, const int64_t total_ticks)
+{
+	r.requests = (int)latency.size();
+	r.seconds  = ticks_to_ms(total_ticks) / 1000.0;
+	if (latency.size()) {
+		std::sort(latency.begin(), latency.end());
+		r.p50_ms = ticks_to_ms(latency[latency.size() / 2]);
+		r.p99_ms = ticks_to_ms(latency[std::min(latency.size() - 1, latency.size() * 99 / 100)]);
+	}
+}
+
+class Bench
+{
+	BenchCallbacks m_callbacks;
+	VDXInputDriverContext m_context = { kVDXPlugin_InputDriverAPIVersion, &m_callbacks };
+	HMODULE m_hPlugin = nullptr;
+	const VDXInputDriverDefinition* m_driverDef = nullptr;
+
+public:
+	~Bench() {
+		if (m_hPlugin) {
+			FreeLibrary(m_hPlugin);
+		}
+	}
+
+	bool LoadPlugin(const std::wstring& path)
+	{
+		m_hPlugin = LoadLibraryW(path.c_str());
+		if (!m_hPlugin) {
+			fwprintf(stderr, L"unable to load %s\n", path.c_str());
+			return false;
+		}
+		auto getInfo = (tpVDXGetPluginInfo)GetProcAddress(m_hPlugin, "VDGetPluginInfo");
+		if (!getInfo) {
+			fwprintf(stderr, L"%s is not a VirtualDub plugin\n", path.c_str());
+			return false;
+		}
+		for (const VDXPluginInfo* const* p = getInfo(); *p; p++) {
+			if ((*p)->mType == kVDXPluginType_Input) {
+				m_driverDef = (const VDXInputDriverDefinition*)(*p)->mpTypeSpecificInfo;
+				break;
+			}
+		}
+		if (!m_driverDef) {
+			fwprintf(stderr, L"no input driver in %s\n", path.c_str());
+			return false;
+		}
+		return true;
+	}
+
+	bool Configure(int io_mode, int latency)
+	{
+		typedef void(__cdecl* tpBenchConfigure)(int io_mode, int io_latency);
+		auto configure = (tpBenchConfigure)GetProcAddress(m_hPlugin, "VDFFBenchConfigure");
+		if (!configure) {
+			fwprintf(stderr, L"the plugin does not support --io and --latency, use the build next to avlib_bench.exe\n");
+			return false;
+		}
+		configure(io_mode, latency);
+		return true;
+	}
+
+	IVDXInputFile* OpenFile(const std::wstring& path)
+	{
+		IVDXInputFileDriver* driver = nullptr;
+		if (!m_driverDef->mpCreate(&m_context, &driver)) {
+			return nullptr;
+		}
+		IVDXInputFile* file = nullptr;
+		driver->CreateInputFile(0, &file);
+		driver->Release();
+		if (!file) {
+			return nullptr;
+		}
+
+		m_callbacks.m_error.clear();
+		file->Init(path.c_str(), nullptr);
+		if (m_callbacks.m_error.size()) {
+			fprintf(stderr, "%s\n", m_callbacks.m_error.c_str());
+			file->Release();
+			return nullptr;
+		}
+		return file;
+	}
+
+	// each pattern works on a freshly opened file, so the cache starts empty
+	bool RunVideo(const std::wstring& path, const std::string& pattern, int count, const unsigned seed, BenchResult& r)
+	{
+		IVDXInputFile* file = OpenFile(path);
+		if (!file) {
+			return false;
+		}
+
+		IVDXVideoSource* vs = nullptr;
+		IVDXVideoDecoder* dec = nullptr;
+		IVDXVideoDecoderModel* model = nullptr;
+		if (!file->GetVideoSource(0, &vs)) {
+			file->Release();
+			return false;
+		}
+		auto ss = (IVDXStreamSource*)vs->AsInterface(IVDXStreamSource::kIID);
+		vs->CreateVideoDecoder(&dec);
+		vs->CreateVideoDecoderModel(&model);
+		dec->SetTargetFormat(nsVDXPixmap::kPixFormat_XRGB8888, false);
+
+		VDXStreamSourceInfo si;
+		ss->GetStreamSourceInfo(si);
+		const int frames = (int)si.mSampleCount;
+		if (frames <= 0) {
+			fprintf(stderr, "the video stream has no frames\n");
+			model->Release();
+			dec->Release();
+			vs->Release();
+			file->Release();
+			return false;
+		}
+		count = std::min(count, frames);
+
+		std::vector<int> order;
+		std::mt19937 rng(seed);
+		if (pattern == "forward") {
+			for (int i = 0; i < count; i++) order.push_back(i);
+		}
+		else if (pattern == "reverse") {
+			for (int i = 0; i < count; i++) order.push_back(frames - 1 - i);
+		}
+		else if (pattern == "random") {
+			std::uniform_int_distribution<int> d(0, frames - 1);
+			for (int i = 0; i < count; i++) order.push_back(d(rng));
+		}
+		else if (pattern == "scrub") {
+			// jump, then a short burst in either direction
+			std::uniform_int_distribution<int> d(0, frames - 1);
+			while ((int)order.size() < count) {
+				const int pos = d(rng);
+				const int dir = (rng() & 1) ? 1 : -1;
+				for (int i = 0; i < 8 && (int)order.size() < count; i++) {
+					order.push_back(std::clamp(pos + i * dir, 0, frames - 1));
+				}
+			}
+		}
+		else if (pattern == "abloop") {
+			const int a = frames / 3;
+			const int b = std::min(a + 60, frames - 1);
+			while ((int)order.size() < count) {
+				for (int i = a; i <= b && (int)order.size() < count; i++) order.push_back(i);
+			}
+		}
+
+		std::vector<int64_t> latency;
+		latency.reserve(order.size());
+		uint8_t buf[16];
+
+		const int64_t t0 = GetPerfTicks();
+		for (const int frame : order) {
+			const int64_t t1 = GetPerfTicks();
+			bool ok = true;
+			model->SetDesiredFrame(frame);
+			bool preroll = false;
+			int64_t sample;
+			while ((sample = model->GetNextRequiredSample(preroll)) != -1 && ok) {
+				uint32 bytes = 0, samples = 0;
+				ok = ss->Read(sample, 1, buf, sizeof(buf), &bytes, &samples);
+				if (ok) {
+					ok = dec->DecodeFrame(buf, bytes, preroll, sample, frame) != nullptr || preroll;
+				}
+			}
+			latency.push_back(GetPerfTicks() - t1);
+			if (!ok) {
+				r.errors++;
+			}
+		}
+		finish_result(r, latency, GetPerfTicks() - t0);
+
+		auto perf = (IVDFFPerfCounters*)vs->AsInterface(IVDFFPerfCounters::kIID);
+		if (perf) {
+			VDFFPerfCounters c;
+			perf->GetPerfCounters(c);
+			r.decoded = c.decoded;
+			r.seeks   = c.seeks;
+		}
+
+		model->Release();
+		dec->Release();
+		vs->Release();
+		file->Release();
+		return true;
+	}
+
+	// time to open the file and create the sources, the demuxer probing dominates on slow storage
+	bool RunOpen(const std::wstring& path, const int count, BenchResult& r)
+	{
+		std::vector<int64_t> latency;
+		const int64_t t0 = GetPerfTicks();
+		for (int i = 0; i < count; i++) {
+			const int64_t t1 = GetPerfTicks();
+			IVDXInputFile* file = OpenFile(path);
+			if (!file) {
+				r.errors++;
+				break;
+			}
+			IVDXVideoSource* vs = nullptr;
+			if (file->GetVideoSource(0, &vs)) {
+				vs->Release();
+			}
+			IVDXAudioSource* as = nullptr;
+			if (file->GetAudioSource(0, &as)) {
+				as->Release();
+			}
+			file->Release();
+			latency.push_back(GetPerfTicks() - t1);
+		}
+		finish_result(r, latency, GetPerfTicks() - t0);
+		return true;
+	}
+
+	bool RunAudio(const std::wstring& path, const int block, int count, BenchResult& r)
+	{
+		IVDXInputFile* file = OpenFile(path);
+		if (!file) {
+			return false;
+		}
+		IVDXAudioSource* as = nullptr;
+		if (!file->GetAudioSource(0, &as)) {
+			file->Release();
+			return false;
+		}
+		auto ss = (IVDXStreamSource*)as->AsInterface(IVDXStreamSource::kIID);
+		as->SetTargetFormat(nullptr);
+		auto fmt = (const VDXWAVEFORMATEX*)ss->GetDirectFormat();
+
+		VDXStreamSourceInfo si;
+		ss->GetStreamSourceInfo(si);
+		std::vector<uint8_t> buf(size_t(block) * fmt->mBlockAlign);
+		std::vector<int64_t> latency;
+
+		int64_t pos = 0;
+		const int64_t t0 = GetPerfTicks();
+		while (pos < si.mSampleCount && count-- > 0) {
+			const int64_t t1 = GetPerfTicks();
+			uint32 bytes = 0, samples = 0;
+			if (!ss->Read(pos, block, buf.data(), (uint32)buf.size(), &bytes, &samples) || !samples) {
+				r.errors++;
+				break;
+			}
+			latency.push_back(GetPerfTicks() - t1);
+			pos += samples;
+		}
+		finish_result(r, latency, GetPerfTicks() - t0);
+
+		auto perf = (IVDFFPerfCounters*)as->AsInterface(IVDFFPerfCounters::kIID);
+		if (perf) {
+			VDFFPerfCounters c;
+			perf->GetPerfCounters(c);
+			r.decoded = c.decoded;
+			r.seeks   = c.seeks;
+		}
+
+		as->Release();
+		file->Release();
+		return true;
+	}
+};
+
+static void print_usage()
+{
+	fputs(
+		"usage: avlib_bench [options] <file>\n"
+		"       avlib_bench [options] --synth <file.mkv>\n"
+		"options:\n"
+		"  --plugin <path>    plugin to load (default: avlib-1.vdplugin next to the executable)\n"
+		"  --pattern <name>   forward, reverse, random, scrub, abloop, audio, open (default: all)\n"
+		"  --count <n>        requests per pattern (default: 500)\n"
+		"  --seed <n>         seed of the random patterns (default: 1)\n"
+		"  --intra            --synth writes an intra-only stream\n"
+		"  --io <mode>        ffmpeg, direct, readahead, mmap, ram, cache (default: the io_mode option)\n"
+		"  --latency <ms>     delay added to every file read, stands in for a file server\n"
+		"  --json             one JSON object per pattern\n",
+		stderr);
+}
+
+int wmain(int argc, wchar_t* argv[])
+{
+	std::wstring plugin_path;
+	std::wstring file_path;
+	std::vector<std::string> patterns;
+	int count = 500;
+	unsigned seed = 1;
+	bool synth = false;
+	bool intra = false;
+	bool json = false;
+	int io_mode = -1;
+	int latency = 0;
+
+	for (int i = 1; i < argc; i++) {
+		const std::wstring_view arg(argv[i]);
+		const bool has_value = i + 1 < argc;
+		if (arg == L"--plugin" && has_value) {
+			plugin_path = argv[++i];
+		} else if (arg == L"--pattern" && has_value) {
+			const std::wstring name(argv[++i]);
+			patterns.emplace_back(name.begin(), name.end());
+		} else if (arg == L"--count" && has_value) {
+			count = _wtoi(argv[++i]);
+		} else if (arg == L"--seed" && has_value) {
+			seed = (unsigned)_wtoi(argv[++i]);
+		} else if (arg == L"--synth") {
+			synth = true;
+		} else if (arg == L"--intra") {
+			intra = true;
+		} else if (arg == L"--json") {
+			json = true;
+		} else if (arg == L"--io" && has_value) {
+			const std::wstring_view modes[] = { L"ffmpeg", L"direct", L"readahead", L"mmap", L"ram", L"cache" };
+			const std::wstring_view mode(argv[++i]);
+			for (int m = 0; m < (int)std::size(modes); m++) {
+				if (mode == modes[m]) {
+					io_mode = m;
+				}
+			}
+			if (io_mode < 0) {
+				print_usage();
+				return 1;
+			}
+		} else if (arg == L"--latency" && has_value) {
+			latency = _wtoi(argv[++i]);
+		} else if (arg[0] != '-' && file_path.empty()) {
+			file_path = arg;
+		} else {
+			print_usage();
+			return 1;
+		}
+	}
+	if (file_path.empty() || count <= 0) {
+		print_usage();
+		return 1;
+	}
+
+	if (synth) {
+		SynthParams params;
+		if (intra) {
+			params.gop = 1;
+		}
+		char utf8[MAX_PATH * 3];
+		WideCharToMultiByte(CP_UTF8, 0, file_path.c_str(), -1, utf8, sizeof(utf8), nullptr, nullptr);
+		std::string error;
+		if (!WriteSynthMedia(utf8, params, error)) {
+			fprintf(stderr, "synth: %s\n", error.c_str());
+			return 2;
+		}
+	}
+
+	if (plugin_path.empty()) {
+		wchar_t buf[MAX_PATH];
+		DWORD len = GetModuleFileNameW(nullptr, buf, MAX_PATH);
+		plugin_path.assign(buf, len);
+		plugin_path.resize(plugin_path.find_last_of(L"\\/") + 1);
+		plugin_path += L"avlib-1.vdplugin";
+	}
+
+	Bench bench;
+	if (!bench.LoadPlugin(plugin_path)) {
+		return 2;
+	}
+	if ((io_mode >= 0 || latency > 0) && !bench.Configure(io_mode, latency)) {
+		return 2;
+	}
+
+	if (patterns.empty()) {
+		patterns = { "forward", "reverse", "random", "scrub", "abloop", "audio", "open" };
+	}
+
+	if (!json) {
+		printf("%-8s %8s %9s %9s %9s %8s %6s %7s %8s %9s\n", "pattern", "requests", "req/s", "p50 ms", "p99 ms", "decoded", "seeks", "errors", "ws MB", "commit MB");
+	}
+
+	int ret = 0;
+	for (const auto& name : patterns) {
+		BenchResult r;
+		r.name = name;
+		MemorySampler memory;
+		memory.Start();
+		bool ok;
+		if (name == "audio") {
+			ok = bench.RunAudio(file_path, 4096, count, r);
+		} else if (name == "open") {
+			ok = bench.RunOpen(file_path, std::min(count, 20), r);
+		} else {
+			ok = bench.RunVideo(file_path, name, count, seed, r);
+		}
+		memory.Stop(r);
+		if (!ok) {
+			fprintf(stderr, "%s: unable to run\n", name.c_str());
+			ret = 2;
+			continue;
+		}
+		if (r.errors) {
+			ret = 3;
+		}
+
+		const double rate = r.seconds > 0 ? r.requests / r.seconds : 0;
+		if (json) {
+			printf("{\"pattern\":\"%s\",\"requests\":%d,\"rate\":%.2f,\"p50_ms\":%.3f,\"p99_ms\":%.3f,\"decoded\":%lld,\"seeks\":%lld,\"errors\":%d,\"peak_working_set_mb\":%.1f,\"peak_commit_mb\":%.1f}\n",
+				r.name.c_str(), r.requests, rate, r.p50_ms, r.p99_ms, r.decoded, r.seeks, r.errors, r.peak_ws_mb, r.peak_commit_mb);
+		} else {
+			printf("%-8s %8d %9.1f %9.3f %9.3f %8lld %6lld %7d %8.1f %9.1f\n",
+				r.name.c_str(), r.requests, rate, r.p50_ms, r.p99_ms, r.decoded, r.seeks, r.errors, r.peak_ws_mb, r.peak_commit_mb);
+		}
+	}
+
+	return ret;
+}
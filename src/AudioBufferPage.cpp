@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2015-2020 Anton Shekhovtsov
+ * Copyright (C) 2023-2026 v0lt
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// built without the precompiled header, the tests compile this file too
+
+#include <algorithm>
+#include <cstring>
+
+#include "AudioBufferPage.h"
+
+int AudioBufferPage::find(int s0) const
+{
+	for (int i = 0; i < (int)ranges.size(); i++) {
+		if (ranges[i].s1 > s0) {
+			return i;
+		}
+	}
+	return (int)ranges.size();
+}
+
+int AudioBufferPage::copy(int s0, uint32_t count, void* dst, int sample_size)
+{
+	int i = find(s0);
+	if (i < (int)ranges.size() && ranges[i].s0 <= s0) {
+		int n = s0 + count < ranges[i].s1 ? count : ranges[i].s1 - s0;
+		memcpy(dst, aud_data + s0 * sample_size, n * sample_size);
+		return n;
+	}
+	return 0;
+}
+
+int AudioBufferPage::empty(int s0, uint32_t count)
+{
+	int i = find(s0);
+	if (i < (int)ranges.size()) {
+		if (ranges[i].s0 <= s0) {
+			return 0;
+		}
+		// gap up to the next range
+		return s0 + count < ranges[i].s0 ? count : ranges[i].s0 - s0;
+	}
+	return s0 + count < size ? count : size - s0;
+}
+
+int AudioBufferPage::alloc(int s0, uint32_t count, int& changed)
+{
+	int n = s0 + count < size ? count : size - s0;
+	int s1 = s0 + n;
+
+	// first range that touches or follows [s0, s1)
+	int i = 0;
+	while (i < (int)ranges.size() && ranges[i].s1 < s0) {
+		i++;
+	}
+	if (i < (int)ranges.size() && ranges[i].s0 <= s0 && ranges[i].s1 >= s1) {
+		// already cached
+		changed = 0;
+		return n;
+	}
+
+	changed = 1;
+
+	// merge all ranges that overlap or adjoin [s0, s1)
+	int j = i;
+	while (j < (int)ranges.size() && ranges[j].s0 <= s1) {
+		s0 = std::min(s0, (int)ranges[j].s0);
+		s1 = std::max(s1, (int)ranges[j].s1);
+		j++;
+	}
+	ranges.erase(ranges.begin() + i, ranges.begin() + j);
+	ranges.insert(ranges.begin() + i, Range{ (uint16_t)s0, (uint16_t)s1 });
+
+	return n;
+}
+
+void AudioBufferPage::erase(int s0, int s1)
+{
+	for (int i = find(s0); i < (int)ranges.size() && ranges[i].s0 < s1;) {
+		Range& r = ranges[i];
+		if (r.s0 < s0 && r.s1 > s1) {
+			// split the range
+			Range tail = { (uint16_t)s1, r.s1 };
+			r.s1 = s0;
+			ranges.insert(ranges.begin() + i + 1, tail);
+			break;
+		}
+		if (r.s0 < s0) {
+			r.s1 = s0;
+			i++;
+		}
+		else if (r.s1 > s1) {
+			r.s0 = s1;
+			break;
+		}
+		else {
+			ranges.erase(ranges.begin() + i);
+		}
+	}
+}
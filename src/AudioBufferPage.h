@@ -0,0 +1,34 @@
+/*
+ * Copyright (C) 2015-2020 Anton Shekhovtsov
+ * Copyright (C) 2023-2026 v0lt
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Page of the audio sample cache.
+// Keeps the list of decoded ranges, does not depend on the plugin and is tested separately.
+struct AudioBufferPage {
+	enum { size = 0x8000 }; // max usable value 0xFFFF
+
+	struct Range {
+		uint16_t s0, s1; // [s0, s1)
+	};
+	std::vector<Range> ranges; // valid samples, sorted, merged on adjacency
+	uint8_t* aud_data = nullptr;
+
+	// copies samples from s0 up to the end of its range, returns 0 if s0 is not cached
+	int copy(int s0, uint32_t count, void* dst, int sample_size);
+	// marks samples as cached, returns the count clamped to the page,
+	// changed is 0 if they already were cached
+	int alloc(int s0, uint32_t count, int& changed);
+	// returns the length of the gap at s0, 0 if s0 is cached
+	int empty(int s0, uint32_t count);
+	void erase(int s0, int s1);
+	// index of the first range that ends after s0
+	int find(int s0) const;
+};
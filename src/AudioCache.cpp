@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2026 v0lt
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "stdafx.h"
+
+#include "AudioCache.h"
+#include "AudioSource2.h"
+#include "Helper.h"
+
+extern float config_audio_cache_size;
+
+AudioCacheBudget& AudioCacheBudget::Instance()
+{
+	static AudioCacheBudget budget;
+	return budget;
+}
+
+AudioCacheBudget::AudioCacheBudget()
+{
+	MEMORYSTATUSEX ms = { sizeof(MEMORYSTATUSEX) };
+	GlobalMemoryStatusEx(&ms);
+
+	const uint64_t gb1 = 0x40000000;
+	m_limit = (uint64_t)(config_audio_cache_size * gb1);
+	// do not take more than a quarter of physical memory
+	m_limit = std::min(m_limit, (uint64_t)ms.ullTotalPhys / 4);
+#ifndef _WIN64
+	m_limit = std::min(m_limit, gb1 / 4);
+#endif
+	// enough for a few pages of 32 channel float
+	m_limit = std::max(m_limit, (uint64_t)64 * 1024 * 1024);
+
+	DLog(L"AudioCacheBudget: {} MB", m_limit / (1024 * 1024));
+}
+
+AudioCacheBudget::Handle AudioCacheBudget::add(VDFFAudioSource* source, int page, size_t bytes)
+{
+	std::lock_guard lock(m_mutex);
+
+	m_bytes += bytes;
+
+	auto it = m_lru.end();
+	while (m_bytes > m_limit && it != m_lru.begin()) {
+		--it;
+		VDFFAudioSource* s = it->source;
+		// the other source may be decoding, then its page stays and an older one is tried
+		// try_lock also prevents a deadlock with a source that waits for m_mutex
+		if (s != source && !s->m_decodeMutex.try_lock()) {
+			continue;
+		}
+		s->drop_page(it->page);
+		if (s != source) {
+			s->m_decodeMutex.unlock();
+		}
+		m_bytes -= it->bytes;
+		it = m_lru.erase(it);
+	}
+
+	m_lru.emplace_front(Entry{ source, page, bytes });
+	return m_lru.begin();
+}
+
+void AudioCacheBudget::touch(Handle h)
+{
+	std::lock_guard lock(m_mutex);
+	m_lru.splice(m_lru.begin(), m_lru, h);
+}
+
+void AudioCacheBudget::remove(Handle h)
+{
+	std::lock_guard lock(m_mutex);
+	m_bytes -= h->bytes;
+	m_lru.erase(h);
+}
+
+void AudioCacheBudget::remove_all(VDFFAudioSource* source)
+{
+	std::lock_guard lock(m_mutex);
+	std::erase_if(m_lru, [&](const Entry& e) {
+		if (e.source == source) {
+			m_bytes -= e.bytes;
+			return true;
+		}
+		return false;
+	});
+}
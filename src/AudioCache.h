@@ -0,0 +1,47 @@
+/*
+ * Copyright (C) 2026 v0lt
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+
+#include <list>
+#include <mutex>
+
+class VDFFAudioSource;
+
+// Byte budget shared by the caches of all audio sources and segments.
+// When the budget is exceeded, pages are evicted in least recently used order
+// across all sources, so busy tracks keep large caches and idle ones shrink.
+class AudioCacheBudget
+{
+public:
+	struct Entry {
+		VDFFAudioSource* source;
+		int page;
+		size_t bytes;
+	};
+	using Handle = std::list<Entry>::iterator;
+
+	static AudioCacheBudget& Instance();
+
+	// All methods expect that the caller holds the decode mutex of the source.
+
+	// registers a new page, may evict pages of this and other sources
+	Handle add(VDFFAudioSource* source, int page, size_t bytes);
+	// marks the page as recently used
+	void touch(Handle h);
+	void remove(Handle h);
+	void remove_all(VDFFAudioSource* source);
+
+	uint64_t get_limit() const { return m_limit; }
+
+private:
+	AudioCacheBudget();
+
+	std::mutex m_mutex;
+	std::list<Entry> m_lru; // most recently used first
+	uint64_t m_bytes = 0;
+	uint64_t m_limit = 0;
+};
@@ -0,0 +1,338 @@
+/*
+ * Copyright (C) 2026 v0lt
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "stdafx.h"
+
+#include "AudioPeaks.h"
+#include "AudioSource2.h"
+#include "InputFile2.h"
+#include "Utils/PeakReduce.h"
+#include "Utils/ThreadPool.h"
+#include "Helper.h"
+#include <cfloat>
+
+const int VDFFAudioPeaks::bin_size[level_count] = { 256, 4096, 65536 };
+
+VDFFAudioPeaks::VDFFAudioPeaks(VDFFAudioSource* source, uint64_t layout, int64_t sample_count)
+	: m_source(source)
+	, m_layout(layout)
+	, m_channels(av_popcount64(layout))
+	, m_sampleCount(sample_count)
+{
+}
+
+VDFFAudioPeaks::~VDFFAudioPeaks()
+{
+	for (auto& src : m_sources) {
+		src->Release();
+	}
+}
+
+bool VDFFAudioPeaks::compute()
+{
+	if (m_done) {
+		return true;
+	}
+	if (m_channels < 1 || m_channels > 32) {
+		return false;
+	}
+
+	const std::wstring path = cache_path();
+	if (path.size() && load(path)) {
+		DLog(L"VDFFAudioPeaks: loaded {}", path);
+		m_done = true;
+		return true;
+	}
+
+	const VDFFPeak empty = { FLT_MAX, -FLT_MAX, 0 };
+	m_levels[0].assign(get_bin_count(0) * m_channels, empty);
+	m_sumsq.assign(m_levels[0].size(), 0);
+	m_failed = false;
+
+	{
+		ThreadPool pool(std::min((int)std::thread::hardware_concurrency(), 8));
+		// ranges are aligned to the largest bin, so no bin is shared by two tasks
+		const int64_t range = (int64_t)bin_size[level_count - 1] * 64;
+		for (int64_t first = 0; first < m_sampleCount; first += range) {
+			const int64_t last = std::min(first + range, m_sampleCount);
+			pool.Push([this, first, last] { range_task(first, last); });
+		}
+		pool.Wait();
+	}
+
+	for (auto& src : m_sources) {
+		src->Release();
+	}
+	m_sources.clear();
+
+	if (m_failed) {
+		m_levels[0].clear();
+		m_sumsq.clear();
+		return false;
+	}
+
+	build_levels();
+	m_sumsq.clear();
+	if (path.size()) {
+		save(path);
+	}
+	m_done = true;
+
+	return true;
+}
+
+void VDFFAudioPeaks::range_task(int64_t first, int64_t last)
+{
+	VDFFAudioSource* src = nullptr;
+	{
+		std::lock_guard lock(m_sourcesMutex);
+		if (m_failed) {
+			return;
+		}
+		if (m_sources.size()) {
+			src = m_sources.back();
+			m_sources.pop_back();
+		}
+	}
+	if (!src) {
+		src = m_source->open_private(m_layout, AV_SAMPLE_FMT_FLT);
+		if (!src) {
+			std::lock_guard lock(m_sourcesMutex);
+			m_failed = true;
+			return;
+		}
+	}
+
+	const int block = bin_size[level_count - 1];
+	std::vector<float> buf((size_t)block * m_channels);
+
+	for (int64_t pos = first; pos < last;) {
+		const uint32_t count = (uint32_t)std::min<int64_t>(block, last - pos);
+		uint32_t bytes = 0;
+		uint32_t samples = 0;
+		{
+			std::lock_guard lock(src->m_decodeMutex);
+			src->read_samples(pos, count, buf.data(), count * m_channels * sizeof(float), &bytes, &samples);
+		}
+		if (!samples) {
+			// the rest stays silent
+			break;
+		}
+
+		// a read may end inside a bin, the next one continues it
+		for (uint32_t i = 0; i < samples;) {
+			const int64_t bin = (pos + i) / bin_size[0];
+			const uint32_t n = std::min<uint32_t>(samples - i, uint32_t((bin + 1) * bin_size[0] - (pos + i)));
+			float vmin[32], vmax[32];
+			double sumsq[32];
+			for (int c = 0; c < m_channels; c++) {
+				VDFFPeak& p = m_levels[0][bin * m_channels + c];
+				vmin[c] = p.min;
+				vmax[c] = p.max;
+				sumsq[c] = m_sumsq[bin * m_channels + c];
+			}
+			ReducePeakSamples(buf.data() + (size_t)i * m_channels, n, m_channels, vmin, vmax, sumsq);
+			for (int c = 0; c < m_channels; c++) {
+				VDFFPeak& p = m_levels[0][bin * m_channels + c];
+				p.min = vmin[c];
+				p.max = vmax[c];
+				m_sumsq[bin * m_channels + c] = sumsq[c];
+			}
+			i += n;
+		}
+		pos += samples;
+	}
+
+	std::lock_guard lock(m_sourcesMutex);
+	m_sources.emplace_back(src);
+}
+
+void VDFFAudioPeaks::build_levels()
+{
+	// level 0 from the sums
+	for (int64_t bin = 0; bin < get_bin_count(0); bin++) {
+		const int64_t n = std::min<int64_t>(bin_size[0], m_sampleCount - bin * bin_size[0]);
+		for (int c = 0; c < m_channels; c++) {
+			VDFFPeak& p = m_levels[0][bin * m_channels + c];
+			if (p.min > p.max) {
+				// never decoded
+				p = {};
+			} else {
+				p.rms = (float)sqrt(m_sumsq[bin * m_channels + c] / n);
+			}
+		}
+	}
+
+	// upper levels from the level below
+	for (int level = 1; level < level_count; level++) {
+		const int ratio = bin_size[level] / bin_size[level - 1];
+		const int64_t bins = get_bin_count(level);
+		const int64_t child_bins = get_bin_count(level - 1);
+		const std::vector<VDFFPeak>& src = m_levels[level - 1];
+		std::vector<VDFFPeak>& dst = m_levels[level];
+		dst.resize(bins * m_channels);
+
+		for (int64_t bin = 0; bin < bins; bin++) {
+			for (int c = 0; c < m_channels; c++) {
+				VDFFPeak p = { FLT_MAX, -FLT_MAX, 0 };
+				double sumsq = 0;
+				int64_t n = 0;
+				for (int64_t child = bin * ratio; child < std::min(child_bins, (bin + 1) * ratio); child++) {
+					const VDFFPeak& s = src[child * m_channels + c];
+					const int64_t cn = std::min<int64_t>(bin_size[level - 1], m_sampleCount - child * bin_size[level - 1]);
+					p.min = std::min(p.min, s.min);
+					p.max = std::max(p.max, s.max);
+					sumsq += (double)s.rms * s.rms * cn;
+					n += cn;
+				}
+				p.rms = n ? (float)sqrt(sumsq / n) : 0;
+				dst[bin * m_channels + c] = p;
+			}
+		}
+	}
+}
+
+struct PeaksFileHeader {
+	uint32_t magic;
+	uint32_t version;
+	int32_t  channels;
+	int32_t  levels;
+	int64_t  sample_count;
+};
+
+const uint32_t peaks_magic = VDXMAKEFOURCC('A', 'V', 'P', 'K');
+const uint64_t peaks_cache_size = 256 * 1024 * 1024; // all files together
+
+// deletes the least recently used files until the cache fits its size, load() renews the write time
+static void prune_cache(const std::wstring& dir)
+{
+	struct CacheFile {
+		std::wstring name;
+		uint64_t size;
+		uint64_t time;
+	};
+	std::vector<CacheFile> files;
+	uint64_t total = 0;
+
+	WIN32_FIND_DATAW fd;
+	HANDLE hFind = FindFirstFileW((dir + L"\\*.peaks").c_str(), &fd);
+	if (hFind == INVALID_HANDLE_VALUE) {
+		return;
+	}
+	do {
+		const uint64_t size = ((uint64_t)fd.nFileSizeHigh << 32) | fd.nFileSizeLow;
+		const uint64_t time = ((uint64_t)fd.ftLastWriteTime.dwHighDateTime << 32) | fd.ftLastWriteTime.dwLowDateTime;
+		files.push_back({ fd.cFileName, size, time });
+		total += size;
+	} while (FindNextFileW(hFind, &fd));
+	FindClose(hFind);
+
+	if (total <= peaks_cache_size) {
+		return;
+	}
+	std::sort(files.begin(), files.end(), [](const CacheFile& a, const CacheFile& b) { return a.time < b.time; });
+	for (const auto& f : files) {
+		if (total <= peaks_cache_size) {
+			break;
+		}
+		if (DeleteFileW((dir + L"\\" + f.name).c_str())) {
+			total -= f.size;
+		}
+	}
+}
+
+std::wstring VDFFAudioPeaks::cache_path()
+{
+	const std::wstring& file = m_source->m_pSource->m_path;
+
+	WIN32_FILE_ATTRIBUTE_DATA fad;
+	if (!GetFileAttributesExW(file.c_str(), GetFileExInfoStandard, &fad)) {
+		return {};
+	}
+
+	// the name depends on the file, its size and time, the stream and the layout
+	std::wstring key = std::format(L"{}|{}|{}|{}|{}|{}|{}", file,
+		fad.nFileSizeHigh, fad.nFileSizeLow, fad.ftLastWriteTime.dwHighDateTime, fad.ftLastWriteTime.dwLowDateTime,
+		m_source->m_streamIndex, m_layout);
+	uint64_t hash = 0xcbf29ce484222325ull; // FNV-1a
+	for (const wchar_t c : key) {
+		hash = (hash ^ (uint16_t)c) * 0x100000001b3ull;
+	}
+
+	wchar_t temp[MAX_PATH];
+	if (!GetTempPathW(MAX_PATH, temp)) {
+		return {};
+	}
+	std::wstring dir = std::wstring(temp) + L"avlib";
+	CreateDirectoryW(dir.c_str(), nullptr);
+	dir += L"\\peaks";
+	CreateDirectoryW(dir.c_str(), nullptr);
+
+	return std::format(L"{}\\{:016x}.peaks", dir, hash);
+}
+
+bool VDFFAudioPeaks::load(const std::wstring& path)
+{
+	HANDLE hFile = CreateFileW(path.c_str(), GENERIC_READ | FILE_WRITE_ATTRIBUTES, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (hFile == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+
+	bool ok = false;
+	PeaksFileHeader header;
+	DWORD n = 0;
+	if (ReadFile(hFile, &header, sizeof(header), &n, nullptr) && n == sizeof(header)
+		&& header.magic == peaks_magic && header.version == 1 && header.channels == m_channels
+		&& header.levels == level_count && header.sample_count == m_sampleCount) {
+		ok = true;
+		for (int level = 0; level < level_count && ok; level++) {
+			m_levels[level].resize(get_bin_count(level) * m_channels);
+			const DWORD size = DWORD(m_levels[level].size() * sizeof(VDFFPeak));
+			ok = ReadFile(hFile, m_levels[level].data(), size, &n, nullptr) && n == size;
+		}
+	}
+	if (ok) {
+		// recently used, see prune_cache
+		FILETIME now;
+		GetSystemTimeAsFileTime(&now);
+		SetFileTime(hFile, nullptr, nullptr, &now);
+	}
+	CloseHandle(hFile);
+
+	if (!ok) {
+		for (auto& level : m_levels) {
+			level.clear();
+		}
+	}
+	return ok;
+}
+
+void VDFFAudioPeaks::save(const std::wstring& path)
+{
+	if (m_levels[0].size() * sizeof(VDFFPeak) > INT_MAX) {
+		return;
+	}
+
+	HANDLE hFile = CreateFileW(path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (hFile == INVALID_HANDLE_VALUE) {
+		return;
+	}
+
+	const PeaksFileHeader header = { peaks_magic, 1, m_channels, level_count, m_sampleCount };
+	DWORD n = 0;
+	bool ok = WriteFile(hFile, &header, sizeof(header), &n, nullptr) && n == sizeof(header);
+	for (int level = 0; level < level_count && ok; level++) {
+		const DWORD size = DWORD(m_levels[level].size() * sizeof(VDFFPeak));
+		ok = WriteFile(hFile, m_levels[level].data(), size, &n, nullptr) && n == size;
+	}
+	CloseHandle(hFile);
+
+	if (!ok) {
+		DeleteFileW(path.c_str());
+		return;
+	}
+	prune_cache(path.substr(0, path.find_last_of(L'\\')));
+}
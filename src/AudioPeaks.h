@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2026 v0lt
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+
+#include <vd2/plugin/vdplugin.h>
+#include <vector>
+#include <mutex>
+
+struct VDFFPeak {
+	float min;
+	float max;
+	float rms;
+};
+
+// Waveform overview of an audio source. Available with AsInterface from audio sources.
+// Level 0, 1 and 2 have 256, 4096 and 65536 samples per bin.
+// Bins are interleaved by channel: bin 0 of all channels, bin 1 of all channels, etc.
+class IVDFFAudioPeaks : public IVDXUnknown {
+public:
+	enum { kIID = VDXMAKEFOURCC('F', 'F', 'p', 'k') };
+	// loads the peaks from the cache or decodes the stream, returns false on error
+	virtual bool    VDXAPIENTRY ComputePeaks() = 0;
+	virtual int     VDXAPIENTRY GetPeakChannels() = 0;
+	virtual int     VDXAPIENTRY GetPeakBinSize(int level) = 0;
+	virtual int64_t VDXAPIENTRY GetPeakBinCount(int level) = 0;
+	// copies up to count bins from first, returns the number of copied bins
+	virtual int64_t VDXAPIENTRY GetPeaks(int level, int64_t first, int64_t count, VDFFPeak* dst) = 0;
+};
+
+class VDFFAudioSource;
+
+// Computes the peak pyramid on a thread pool. Each task decodes an independent range
+// with its own private source, so the ranges are decoded in parallel.
+// The result is cached in %TEMP%\avlib\peaks, the least recently used files are deleted above 256 MB.
+class VDFFAudioPeaks
+{
+public:
+	enum { level_count = 3 };
+	static const int bin_size[level_count];
+
+	VDFFAudioPeaks(VDFFAudioSource* source, uint64_t layout, int64_t sample_count);
+	~VDFFAudioPeaks();
+
+	bool compute();
+	bool is_done() const { return m_done; }
+	int get_channels() const { return m_channels; }
+	int64_t get_bin_count(int level) const { return (m_sampleCount + bin_size[level] - 1) / bin_size[level]; }
+	const VDFFPeak* get_bins(int level) const { return m_levels[level].data(); }
+
+private:
+	VDFFAudioSource* m_source;
+	uint64_t m_layout;
+	int      m_channels;
+	int64_t  m_sampleCount;
+	bool     m_done = false;
+
+	std::vector<VDFFPeak> m_levels[level_count];
+	std::vector<double>   m_sumsq; // level 0, squares for the upper levels
+
+	std::mutex m_sourcesMutex;
+	std::vector<VDFFAudioSource*> m_sources; // idle private sources
+	bool m_failed = false;
+
+	void range_task(int64_t first, int64_t last);
+	void build_levels();
+	std::wstring cache_path();
+	bool load(const std::wstring& path);
+	void save(const std::wstring& path);
+};
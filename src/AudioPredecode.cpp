@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2026 v0lt
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "stdafx.h"
+
+#include "AudioPredecode.h"
+#include "AudioSource2.h"
+#include "Helper.h"
+
+VDFFAudioPredecode* VDFFAudioPredecode::Create(VDFFAudioSource* source, int64_t sample_count, int block_align, bool unsigned8)
+{
+	const int64_t size = sample_count * block_align;
+
+	wchar_t temp_path[MAX_PATH];
+	wchar_t file_path[MAX_PATH];
+	if (size <= 0 || !GetTempPathW(MAX_PATH, temp_path) || !GetTempFileNameW(temp_path, L"avl", 0, file_path)) {
+		source->Release();
+		return nullptr;
+	}
+
+	VDFFAudioPredecode* p = new VDFFAudioPredecode;
+	p->m_source = source;
+
+	p->m_hFile = CreateFileW(file_path, GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS,
+		FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE, nullptr);
+	if (p->m_hFile != INVALID_HANDLE_VALUE) {
+		LARGE_INTEGER li;
+		li.QuadPart = size;
+		p->m_hMapping = CreateFileMappingW(p->m_hFile, nullptr, PAGE_READWRITE, li.HighPart, li.LowPart, nullptr);
+	}
+	if (p->m_hMapping) {
+		p->m_pData = (uint8_t*)MapViewOfFile(p->m_hMapping, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+	}
+	if (!p->m_pData) {
+		DLog(L"VDFFAudioPredecode: unable to create a file of {} bytes", size);
+		delete p;
+		return nullptr;
+	}
+
+	p->m_thread = std::thread([p, unsigned8, size] {
+		if (unsigned8) {
+			// silence for gaps and the end of the stream
+			memset(p->m_pData, 0x80, (size_t)size);
+		}
+		p->m_source->predecode(p->m_pData, p->m_ready, p->m_stop);
+	});
+
+	return p;
+}
+
+VDFFAudioPredecode::~VDFFAudioPredecode()
+{
+	m_stop = true;
+	if (m_thread.joinable()) {
+		m_thread.join();
+	}
+	if (m_pData) {
+		UnmapViewOfFile(m_pData);
+	}
+	if (m_hMapping) {
+		CloseHandle(m_hMapping);
+	}
+	if (m_hFile != INVALID_HANDLE_VALUE) {
+		CloseHandle(m_hFile);
+	}
+	if (m_source) {
+		m_source->Release();
+	}
+}
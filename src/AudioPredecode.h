@@ -0,0 +1,40 @@
+/*
+ * Copyright (C) 2026 v0lt
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+
+#include <thread>
+#include <atomic>
+
+class VDFFAudioSource;
+
+// Decodes a whole audio track in the background into a temporary file
+// of output PCM samples mapped into memory. Read() serves every position
+// below get_ready() with a memcpy, without demuxer seeks or decoder preroll.
+class VDFFAudioPredecode
+{
+public:
+	// source is a private instance for decoding, the object takes over its reference
+	// returns nullptr if the file cannot be created
+	static VDFFAudioPredecode* Create(VDFFAudioSource* source, int64_t sample_count, int block_align, bool unsigned8);
+	~VDFFAudioPredecode();
+
+	// samples [0, get_ready()) are available
+	int64_t get_ready() const { return m_ready.load(std::memory_order_acquire); }
+	const uint8_t* get_data() const { return m_pData; }
+
+private:
+	VDFFAudioPredecode() = default;
+
+	VDFFAudioSource* m_source = nullptr;
+	HANDLE   m_hFile    = INVALID_HANDLE_VALUE;
+	HANDLE   m_hMapping = nullptr;
+	uint8_t* m_pData    = nullptr;
+
+	std::thread m_thread;
+	std::atomic<int64_t> m_ready = 0;
+	std::atomic<bool> m_stop = false;
+};
@@ -1,4 +1,4 @@
-/*
+﻿/*
  * Copyright (C) 2015-2020 Anton Shekhovtsov
  * Copyright (C) 2023-2025 v0lt
  *
@@ -9,10 +9,21 @@
 
 #include "InputFile2.h"
 #include "AudioSource2.h"
+#include "AudioCache.h"
+#include "DemuxHub.h"
+#include "AudioPredecode.h"
+#include "FilePool.h"
+#include "ProbeCache.h"
+#include "IOBackend.h"
 #include "Utils/StringUtil.h"
+#include "Utils/Interleave.h"
 #include "Helper.h"
 #include "ffmpeg_helper.h"
 
+extern int config_audio_read_ahead;
+extern bool config_audio_predecode;
+extern int config_segment_idle;
+
 VDFFAudioSource::VDFFAudioSource(const VDXInputDriverContext& context)
 	:mContext(context)
 {
@@ -20,6 +31,20 @@ VDFFAudioSource::VDFFAudioSource(const VDXInputDriverContext& context)
 
 VDFFAudioSource::~VDFFAudioSource()
 {
+	m_predecode.reset();
+	m_peaks.reset();
+	if (m_readAheadThread.joinable()) {
+		{
+			std::lock_guard lock(m_decodeMutex);
+			m_readAheadStop = true;
+		}
+		m_cvReadAhead.notify_all();
+		m_readAheadThread.join();
+	}
+	{
+		std::lock_guard lock(m_decodeMutex);
+		AudioCacheBudget::Instance().remove_all(this);
+	}
 	if (m_pFrame) {
 		av_frame_free(&m_pFrame);
 	}
@@ -29,9 +54,7 @@ VDFFAudioSource::~VDFFAudioSource()
 	if (m_pSwrCtx) {
 		swr_free(&m_pSwrCtx);
 	}
-	if (m_pFormatCtx) {
-		avformat_close_input(&m_pFormatCtx);
-	}
+	close_demuxer();
 	for (auto& page : buffer) {
 		free(page.aud_data);
 	}
@@ -52,6 +75,12 @@ void* VDXAPIENTRY VDFFAudioSource::AsInterface(uint32_t iid)
 	if (iid == IVDXAudioSource::kIID)
 		return static_cast<IVDXAudioSource*>(this);
 
+	if (iid == IVDFFPerfCounters::kIID)
+		return static_cast<IVDFFPerfCounters*>(this);
+
+	if (iid == IVDFFAudioPeaks::kIID)
+		return static_cast<IVDFFAudioPeaks*>(this);
+
 	return vdxunknown<IVDXStreamSource>::AsInterface(iid);
 }
 
@@ -71,9 +100,17 @@ uint64_t GetChannelLayout(AVCodecContext* pCodecCtx)
 
 int VDFFAudioSource::initStream(VDFFInputFile* pSource, int streamIndex)
 {
-	m_pFormatCtx = OpenAudioFile(pSource->m_path, streamIndex);
-	if (!m_pFormatCtx) {
-		return -1;
+	if (!m_privateInstance) {
+		m_hub = pSource->get_audio_hub();
+	}
+	if (m_hub && m_hub->attach(streamIndex)) {
+		m_pFormatCtx = m_hub->get_context();
+	} else {
+		m_hub.reset();
+		m_pFormatCtx = OpenAudioFile(pSource, streamIndex);
+		if (!m_pFormatCtx) {
+			return -1;
+		}
 	}
 
 	m_pSource = pSource;
@@ -99,9 +136,7 @@ int VDFFAudioSource::initStream(VDFFInputFile* pSource, int streamIndex)
 		return -1;
 	}
 
-	const AVRational tb = m_pStream->time_base;
-	// should normally reduce to integer if timebase is derived from sample_rate
-	av_reduce(&time_base.num, &time_base.den, (int64_t)m_pCodecCtx->sample_rate * tb.num, tb.den, INT_MAX);
+	init_duration(m_pFormatCtx, m_pStream);
 
 	if (time_base.den == 1) {
 		trust_sample_pos = true; // works for mp4
@@ -109,27 +144,6 @@ int VDFFAudioSource::initStream(VDFFInputFile* pSource, int streamIndex)
 		trust_sample_pos = false;
 	}
 
-	if (m_pStream->duration == AV_NOPTS_VALUE) {
-		/*
-		const char* class_name = m_pFormatCtx->iformat->priv_class->class_name;
-		if(strcmp(class_name,"avi")==0){
-			// pcm avi has it here, maybe bug in avidec
-			// not using this now as there is no win
-			sample_count = m_pStream->nb_frames;
-		} else*/ {
-		// this gives inexact value
-			if (m_pFormatCtx->duration == AV_NOPTS_VALUE) {
-				// fill 10 hours
-				sample_count = int64_t(3600 * 10) * m_pCodecCtx->sample_rate;
-			} else {
-				sample_count = (m_pFormatCtx->duration * m_pCodecCtx->sample_rate + AV_TIME_BASE / 2) / AV_TIME_BASE;
-			}
-		}
-	}
-	else {
-		sample_count = (m_pStream->duration * time_base.num + time_base.den / 2) / time_base.den;
-	}
-
 	use_keys = false;
 	int nb_index_entries = avformat_index_get_entries_count(m_pStream);
 	if (nb_index_entries < 60) {
@@ -139,8 +153,8 @@ int VDFFAudioSource::initStream(VDFFInputFile* pSource, int streamIndex)
 		// works for MKV and FLV
 		const AVIndexEntry* ie = avformat_index_get_entry(m_pStream, nb_index_entries - 1);
 		if (ie) {
-			seek_frame(m_pFormatCtx, m_streamIndex, ie->pos, AVSEEK_FLAG_BACKWARD);
-			seek_frame(m_pFormatCtx, m_streamIndex, AV_SEEK_START, AVSEEK_FLAG_BACKWARD);
+			demux_seek(ie->pos, AVSEEK_FLAG_BACKWARD, true);
+			demux_seek(AV_SEEK_START, AVSEEK_FLAG_BACKWARD, true);
 			// get the number of index entries again
 			nb_index_entries = avformat_index_get_entries_count(m_pStream);
 		}
@@ -153,6 +167,31 @@ int VDFFAudioSource::initStream(VDFFInputFile* pSource, int streamIndex)
 		}
 	}
 
+	// the demuxer index gives the first packet boundaries,
+	// the rest is collected while the packets are read
+	packet_index.clear();
+	for (int i = 0; i < nb_index_entries; i++) {
+		const AVIndexEntry* ie = avformat_index_get_entry(m_pStream, i);
+		if (ie->flags & AVINDEX_KEYFRAME) {
+			add_packet_index(ie->timestamp);
+		}
+	}
+	preroll_samples = get_preroll();
+
+	if (m_hub) {
+		// the shared demuxer may be anywhere
+		demux_seek(AV_SEEK_START, AVSEEK_FLAG_BACKWARD, true);
+	}
+	// used by init_start_time
+	first_pts = AV_NOPTS_VALUE;
+	{
+		std::unique_ptr<AVPacket, std::function<void(AVPacket*)>> pkt{ av_packet_alloc(), [](AVPacket* p) { av_packet_free(&p); } };
+		if (demux_read(pkt.get()) == 0) {
+			first_pts = pkt->pts;
+			av_packet_unref(pkt.get());
+		}
+	}
+
 	// lazy initialized by init_start_time
 	// requires video to initialize first
 	start_time = AV_NOPTS_VALUE;
@@ -176,10 +215,6 @@ int VDFFAudioSource::initStream(VDFFInputFile* pSource, int streamIndex)
 
 	m_pFrame = av_frame_alloc();
 
-	first_page     = 0;
-	last_page      = 0;
-	used_pages     = 0;
-	used_pages_max = 1024;
 	size_t buffer_size = (int)((sample_count + BufferPage::size - 1) / BufferPage::size);
 	buffer.clear();
 	buffer.resize(buffer_size);
@@ -190,23 +225,123 @@ int VDFFAudioSource::initStream(VDFFInputFile* pSource, int streamIndex)
 	return 0;
 }
 
-AVFormatContext* VDFFAudioSource::OpenAudioFile(std::wstring_view path, int streamIndex)
+void VDFFAudioSource::init_duration(const AVFormatContext* fmt, const AVStream* st)
+{
+	const int sample_rate = st->codecpar->sample_rate;
+	const AVRational tb = st->time_base;
+	// should normally reduce to integer if timebase is derived from sample_rate
+	av_reduce(&time_base.num, &time_base.den, (int64_t)sample_rate * tb.num, tb.den, INT_MAX);
+
+	const int64_t end_pts = m_pSource->get_end_pts(st->index);
+	if (end_pts != AV_NOPTS_VALUE) {
+		// exact end from the tail of the file
+		const int64_t start_pts = (st->start_time != AV_NOPTS_VALUE) ? st->start_time : 0;
+		sample_count = std::max<int64_t>(0, ((end_pts - start_pts) * time_base.num + time_base.den / 2) / time_base.den);
+	}
+	else if (st->duration == AV_NOPTS_VALUE) {
+		/*
+		const char* class_name = fmt->iformat->priv_class->class_name;
+		if(strcmp(class_name,"avi")==0){
+			// pcm avi has it here, maybe bug in avidec
+			// not using this now as there is no win
+			sample_count = st->nb_frames;
+		} else*/ {
+		// this gives inexact value
+			if (fmt->duration == AV_NOPTS_VALUE) {
+				// fill 10 hours
+				sample_count = int64_t(3600 * 10) * sample_rate;
+				sample_count_estimated = true;
+			} else {
+				sample_count = (fmt->duration * sample_rate + AV_TIME_BASE / 2) / AV_TIME_BASE;
+			}
+		}
+	}
+	else {
+		sample_count = (st->duration * time_base.num + time_base.den / 2) / time_base.den;
+	}
+}
+
+int VDFFAudioSource::initSegment(VDFFInputFile* pSource, int streamIndex)
+{
+	m_pSource = pSource;
+	m_streamIndex = streamIndex;
+
+	// the context that was probed for the video, the stream gets its own demuxer when it is opened
+	const AVFormatContext* fmt = pSource->m_pFormatCtx;
+	const AVStream* st = fmt->streams[streamIndex];
+	if (st->codecpar->sample_rate <= 0) {
+		mContext.mpCallbacks->SetError("FFMPEG: Unsupported audio sample rate (%d)", st->codecpar->sample_rate);
+		return -1;
+	}
+	init_duration(fmt, st);
+
+	m_streamInfo.mSampleCount = sample_count;
+	m_streamInfo.mSampleRate.mNumerator = st->codecpar->sample_rate;
+	m_streamInfo.mSampleRate.mDenominator = 1;
+	m_deferred = true;
+
+	return 0;
+}
+
+bool VDFFAudioSource::init_deferred()
+{
+	if (!m_deferred) {
+		return true;
+	}
+	std::lock_guard lock(m_initMutex);
+	if (!m_deferred) {
+		return true;
+	}
+
+	// left by an attempt that failed, the pre-warming thread may try first
+	av_frame_free(&m_pFrame);
+	avcodec_free_context(&m_pCodecCtx);
+	close_demuxer();
+
+	const int64_t count = sample_count;
+	if (initStream(m_pSource, m_streamIndex) < 0) {
+		sample_count = count;
+		return false;
+	}
+	if (sample_count != count) {
+		// keep the length that was reported to the host
+		DLog(L"VDFFAudioSource: segment has {} samples, {} expected", sample_count, count);
+		std::lock_guard decode_lock(m_decodeMutex);
+		reset_cache();
+		sample_count = count;
+		m_streamInfo.mSampleCount = sample_count;
+		buffer.resize((size_t)((sample_count + BufferPage::size - 1) / BufferPage::size));
+		start_predecode();
+	}
+
+	m_deferred = false;
+	DLog(L"VDFFAudioSource: opened segment {}", m_pSource->m_path);
+
+	return true;
+}
+
+AVFormatContext* VDFFAudioSource::OpenAudioFile(VDFFInputFile* pSource, int streamIndex)
 {
 	assert(streamIndex >= 0);
 
-	std::string ff_path = ConvertWideToUtf8(path);
+	// the file was already probed for its video, reuse the format and the stream information,
+	// a copy because the video may be demuxing on another thread
+	const AVFormatContext* probed = pSource->stream_info;
+	const AVInputFormat* iformat = probed ? probed->iformat : nullptr;
 
 	AVFormatContext* fmt = nullptr;
-	int err = avformat_open_input(&fmt, ff_path.c_str(), nullptr, nullptr);
+	int err = pSource->head_segment
+		? VDFFFilePool::Instance().open_input(&fmt, pSource->m_path, iformat)
+		: VDFFIOBackend::open_input(&fmt, pSource->m_path, iformat);
 	if (err < 0) {
 		mContext.mpCallbacks->SetError("FFMPEG open failure:\n%s", get_last_av_error().c_str());
 		return nullptr;
 	}
 
-	err = avformat_find_stream_info(fmt, nullptr);
+	err = VDFFProbeCache::find_stream_info(fmt, probed);
 	if (err < 0) {
 		mContext.mpCallbacks->SetError("FFMPEG: Couldn't find stream information of file.");
-		avformat_close_input(&fmt);
+		VDFFFilePool::close_input(&fmt);
 		return nullptr;
 	}
 
@@ -224,6 +359,8 @@ AVFormatContext* VDFFAudioSource::OpenAudioFile(std::wstring_view path, int stre
 
 void VDFFAudioSource::SetTargetFormat(const VDXWAVEFORMATEX* target)
 {
+	std::lock_guard lock(m_decodeMutex);
+
 	const uint64_t in_layout = GetChannelLayout(m_pCodecCtx);
 
 	uint64_t layout = in_layout;
@@ -276,6 +413,12 @@ void VDFFAudioSource::SetTargetFormat(const VDXWAVEFORMATEX* target)
 		out_fmt = a0->out_fmt;
 	}
 
+	apply_output_format();
+	start_predecode();
+}
+
+void VDFFAudioSource::apply_output_format()
+{
 	av_samples_get_buffer_size(&src_linesize, m_pCodecCtx->ch_layout.nb_channels, 1, m_pCodecCtx->sample_fmt, 1);
 
 	mRawFormat.Format.wFormatTag      = WAVE_FORMAT_PCM;
@@ -321,6 +464,19 @@ int VDFFAudioSource::reset_swr()
 	swr_layout = in_layout;
 	swr_rate = m_pCodecCtx->sample_rate;
 	swr_fmt = m_pCodecCtx->sample_fmt;
+	av_samples_get_buffer_size(&src_linesize, m_pCodecCtx->ch_layout.nb_channels, 1, m_pCodecCtx->sample_fmt, 1);
+
+	// swr is needed only for real layout or format conversion
+	convert_mode = convert_swr;
+	if (in_layout == out_layout) {
+		const int sample_size = av_get_bytes_per_sample(out_fmt);
+		if (swr_fmt == out_fmt) {
+			convert_mode = convert_copy;
+		}
+		else if (swr_fmt == av_get_planar_sample_fmt(out_fmt) && (sample_size == 2 || sample_size == 4) && av_popcount64(out_layout) <= 8) {
+			convert_mode = convert_interleave;
+		}
+	}
 
 	if (m_pSwrCtx) {
 		swr_free(&m_pSwrCtx);
@@ -351,22 +507,6 @@ int VDFFAudioSource::reset_swr()
 
 void VDFFAudioSource::init_start_time()
 {
-	int64_t first_pts = AV_NOPTS_VALUE;
-	while (1) {
-		std::unique_ptr<AVPacket, std::function<void(AVPacket*)>> pkt{ av_packet_alloc(), [](AVPacket* p) { av_packet_free(&p); } };
-		
-		int ret = av_read_frame(m_pFormatCtx, pkt.get());
-		if (ret < 0) {
-			break;
-		}
-		if (pkt->stream_index == m_streamIndex) {
-			first_pts = pkt->pts;
-			av_packet_unref(pkt.get());
-			break;
-		}
-		av_packet_unref(pkt.get());
-	}
-
 	start_time = m_pStream->start_time;
 	if (start_time == AV_NOPTS_VALUE) {
 		start_time = 0;
@@ -405,12 +545,18 @@ int64_t VDFFAudioSource::frame_to_pts(int64_t frame, AVStream* video)
 
 bool VDFFAudioSource::Read(int64_t start, uint32_t count, void* lpBuffer, uint32_t cbBuffer, uint32_t* lBytesRead, uint32_t* lSamplesRead)
 {
+	if (!m_privateInstance && m_pSource->check_growth(m_growth)) {
+		grow();
+	}
+
 	if (start >= sample_count) {
-		if (m_pSource->next_segment) {
-			VDFFAudioSource* a1 = m_pSource->next_segment->audio_source;
-			if (a1) {
-				return a1->Read(start - sample_count, count, lpBuffer, cbBuffer, lBytesRead, lSamplesRead);
-			}
+		int64_t pos = start - sample_count;
+		if (VDFFAudioSource* a1 = m_pSource->find_audio_segment(pos)) {
+			return a1->Read(pos, count, lpBuffer, cbBuffer, lBytesRead, lSamplesRead);
+		}
+		if (m_pSource->next_segment && m_pSource->next_segment->audio_source) {
+			// the segment could not be opened, the error is set
+			return false;
 		}
 	}
 
@@ -420,12 +566,36 @@ bool VDFFAudioSource::Read(int64_t start, uint32_t count, void* lpBuffer, uint32
 		return false;
 	}
 
+	release_idle_segments();
+	prewarm_next(start + count);
+
+	// the read-ahead thread gives way while the host is waiting
+	m_hostWaiting++;
+	std::unique_lock lock(m_decodeMutex);
+	m_hostWaiting--;
+
+	bool ret = read_samples(start, count, lpBuffer, cbBuffer, lBytesRead, lSamplesRead);
+
+	if (ret && config_audio_read_ahead > 0 && !(m_predecode && m_predecode->get_ready() == sample_count)) {
+		m_readAheadFrom = start;
+		m_readAheadEnd = start + *lSamplesRead + (int64_t)config_audio_read_ahead * m_pCodecCtx->sample_rate / 1000;
+		if (!m_readAheadThread.joinable()) {
+			m_readAheadThread = std::thread(&VDFFAudioSource::read_ahead_thread, this);
+		}
+	}
+	lock.unlock();
+	m_cvReadAhead.notify_one();
+
+	return ret;
+}
+
+bool VDFFAudioSource::read_samples(int64_t start, uint32_t count, void* lpBuffer, uint32_t cbBuffer, uint32_t* lBytesRead, uint32_t* lSamplesRead)
+{
 	if (start_time == AV_NOPTS_VALUE) {
 		init_start_time();
 	}
 
 	int px = (int)(start / BufferPage::size);
-	int s0 = start % BufferPage::size;
 
 	if (px < 0 || px >= (int)buffer.size()) {
 		*lBytesRead = 0;
@@ -436,6 +606,10 @@ bool VDFFAudioSource::Read(int64_t start, uint32_t count, void* lpBuffer, uint32
 	if (count * mRawFormat.Format.nBlockAlign > cbBuffer) {
 		count = cbBuffer / mRawFormat.Format.nBlockAlign;
 	}
+	// the rest belongs to the next segment
+	if (start < sample_count && start + count > sample_count) {
+		count = uint32_t(sample_count - start);
+	}
 
 	if (count == 0) {
 		*lBytesRead = 0;
@@ -443,6 +617,17 @@ bool VDFFAudioSource::Read(int64_t start, uint32_t count, void* lpBuffer, uint32
 		return false;
 	}
 
+	if (m_predecode && start + count <= m_predecode->get_ready()) {
+		// the whole track is decoded up to here
+		PerfTimer timer(m_perf.copy_time);
+		memcpy(lpBuffer, m_predecode->get_data() + start * mRawFormat.Format.nBlockAlign, count * mRawFormat.Format.nBlockAlign);
+		m_perf.cache_hits++;
+		m_perf.delivered += count;
+		*lBytesRead = count * mRawFormat.Format.nBlockAlign;
+		*lSamplesRead = count;
+		return true;
+	}
+
 	if (start_time > 0) {
 		int64_t real_start = start_time * time_base.num / time_base.den;
 		if (start < real_start) {
@@ -453,25 +638,52 @@ bool VDFFAudioSource::Read(int64_t start, uint32_t count, void* lpBuffer, uint32
 		}
 	}
 
-	int n = buffer[px].copy(s0, count, lpBuffer, mRawFormat.Format.nBlockAlign);
+	// fill the whole request, page by page
+	uint8_t* dst = (uint8_t*)lpBuffer;
+	uint32_t done = 0;
+	while (done < count) {
+		int n = read_block(start + done, count - done, dst + done * mRawFormat.Format.nBlockAlign);
+		if (n <= 0) {
+			break;
+		}
+		done += n;
+	}
+
+	*lBytesRead = done * mRawFormat.Format.nBlockAlign;
+	*lSamplesRead = done;
+	return done > 0;
+}
+
+int VDFFAudioSource::read_block(int64_t start, uint32_t count, uint8_t* dst)
+{
+	int px = (int)(start / BufferPage::size);
+	int s0 = start % BufferPage::size;
+
+	if (px >= (int)buffer.size()) {
+		return 0;
+	}
+	m_privateReadPage = px;
+
+	int n;
+	{
+		PerfTimer timer(m_perf.copy_time);
+		n = buffer[px].copy(s0, count, dst, mRawFormat.Format.nBlockAlign);
+	}
 	if (n > 0) {
-		*lBytesRead = n * mRawFormat.Format.nBlockAlign;
-		*lSamplesRead = n;
-		return true;
+		if (!m_privateInstance) {
+			AudioCacheBudget::Instance().touch(buffer[px].lru);
+		}
+		m_perf.cache_hits++;
+		m_perf.delivered += n;
+		return n;
 	}
+	m_perf.cache_misses++;
 
+	int seek_retries = -1;
 	if (next_sample == AV_NOPTS_VALUE || start > next_sample + m_pCodecCtx->sample_rate || start < next_sample) {
 		// required to seek
-		discard_samples = int(start >= 4096 ? 4096 : start);
-		int64_t pos = (start - discard_samples) * time_base.den / time_base.num - time_adjust;
-		if (start == 0) {
-			pos = AV_SEEK_START;
-			discard_samples = 0;
-		}
-		avcodec_flush_buffers(m_pCodecCtx);
-		int flags = use_keys ? 0 : AVSEEK_FLAG_ANY;
-		seek_frame(m_pFormatCtx, m_streamIndex, pos, AVSEEK_FLAG_BACKWARD | flags);
-		next_sample = AV_NOPTS_VALUE;
+		seek_to(start, 0);
+		seek_retries = 0;
 	}
 
 	std::unique_ptr<AVPacket, std::function<void(AVPacket*)>> pkt{ av_packet_alloc(), [](AVPacket* p) { av_packet_free(&p); } };
@@ -479,35 +691,23 @@ bool VDFFAudioSource::Read(int64_t start, uint32_t count, void* lpBuffer, uint32
 	ReadInfo ri;
 
 	while (1) {
-		int ret = av_read_frame(m_pFormatCtx, pkt.get());
+		int ret = decode_packet(pkt.get(), ri);
+		if (ret == AVERROR(EAGAIN)) {
+			seek_to(start, 0);
+			seek_retries = 0;
+			ri = {};
+			continue;
+		}
+		if (ret == AVERROR(ENOMEM)) {
+			mContext.mpCallbacks->SetErrorOutOfMemory();
+			return -1;
+		}
 		if (ret < 0) {
 			// typically end of stream
 			// may result from inexact sample_count too
 			//insert_silence(start,count);
 			ri.last_sample = start;
 		}
-		else {
-			if (pkt->stream_index != m_streamIndex) {
-				av_packet_unref(pkt.get());
-				continue;
-			}
-
-			auto pkt_data_orig = pkt->data;
-			auto pkt_size_orig = pkt->size;
-
-			do {
-				int s = read_packet(pkt.get(), ri);
-				if (s < 0) {
-					break;
-				}
-				pkt->data += s;
-				pkt->size -= s;
-			} while (pkt->size > 0);
-
-			pkt->data = pkt_data_orig;
-			pkt->size = pkt_size_orig;
-			av_packet_unref(pkt.get());
-		}
 
 		if (ri.last_sample < start) {
 			continue;
@@ -523,25 +723,287 @@ bool VDFFAudioSource::Read(int64_t start, uint32_t count, void* lpBuffer, uint32
 		}
 		*/
 
-		n = buffer[px].copy(s0, count, lpBuffer, mRawFormat.Format.nBlockAlign);
+		{
+			PerfTimer timer(m_perf.copy_time);
+			n = buffer[px].copy(s0, count, dst, mRawFormat.Format.nBlockAlign);
+		}
 		if (n > 0) {
-			*lBytesRead = n * mRawFormat.Format.nBlockAlign;
-			*lSamplesRead = n;
-			return true;
+			m_perf.delivered += n;
+			return n;
+		}
+		else if (seek_retries >= 0 && seek_retries < 3 && ri.first_sample > start) {
+			// the seek landed after the required sample, go back further
+			seek_retries++;
+			seek_to(start, seek_retries * m_pCodecCtx->sample_rate);
+			ri = {};
 		}
 		else {
 			// seek/decode missed required sample
 			n = buffer[px].empty(s0, count);
-			write_silence(lpBuffer, n);
-			*lBytesRead = n * mRawFormat.Format.nBlockAlign;
-			*lSamplesRead = n;
-			return true;
+			write_silence(dst, n);
+			return n;
+		}
+	}
+}
+
+void VDFFAudioSource::seek_to(int64_t start, int backoff)
+{
+	int64_t pos = AV_SEEK_START;
+	discard_samples = 0;
+
+	const int64_t target = start - preroll_samples - backoff;
+	if (target > 0) {
+		pos = find_seek_pts(target);
+		if (pos != AV_NOPTS_VALUE) {
+			// exact packet boundary, only the decoder preroll is thrown away
+			discard_samples = preroll_samples;
+		} else {
+			discard_samples = int(start >= 4096 ? 4096 : start);
+			int64_t sample = start - discard_samples - backoff;
+			if (sample > 0) {
+				pos = sample * time_base.den / time_base.num - time_adjust;
+			} else {
+				pos = AV_SEEK_START;
+				discard_samples = 0;
+			}
+		}
+	}
+
+	m_perf.seeks++;
+	avcodec_flush_buffers(m_pCodecCtx);
+	int flags = use_keys ? 0 : AVSEEK_FLAG_ANY;
+	demux_seek(pos, AVSEEK_FLAG_BACKWARD | flags, false);
+	next_sample = AV_NOPTS_VALUE;
+	m_readAheadEof = false;
+}
+
+int64_t VDFFAudioSource::find_seek_pts(int64_t sample)
+{
+	const int64_t pts = sample * time_base.den / time_base.num - time_adjust;
+
+	auto it = std::upper_bound(packet_index.begin(), packet_index.end(), pts);
+	if (it == packet_index.begin()) {
+		return AV_NOPTS_VALUE;
+	}
+	--it;
+
+	// packets between the entry and the target may be unknown,
+	// do not trust the entry if it is too far away
+	const int64_t gap = (pts - *it) * time_base.num / time_base.den;
+	if (gap > m_pCodecCtx->sample_rate) {
+		return AV_NOPTS_VALUE;
+	}
+
+	return *it;
+}
+
+void VDFFAudioSource::add_packet_index(int64_t pts)
+{
+	if (packet_index.empty() || pts > packet_index.back()) {
+		packet_index.emplace_back(pts);
+		return;
+	}
+	auto it = std::lower_bound(packet_index.begin(), packet_index.end(), pts);
+	if (*it != pts) {
+		packet_index.insert(it, pts);
+	}
+}
+
+int VDFFAudioSource::get_preroll()
+{
+	// samples the decoder needs after a seek before the output is valid
+	// Opus pre-skip (312) and AAC priming are applied by FFmpeg at the stream start only
+	const AVCodecParameters* par = m_pStream->codecpar;
+	int preroll = par->seek_preroll;
+
+	if (av_get_exact_bits_per_sample(par->codec_id) > 0) {
+		// PCM
+		return preroll;
+	}
+
+	switch (par->codec_id) {
+	case AV_CODEC_ID_FLAC:
+	case AV_CODEC_ID_ALAC:
+	case AV_CODEC_ID_WAVPACK:
+	case AV_CODEC_ID_TTA:
+		// independent frames
+		break;
+	case AV_CODEC_ID_AAC:
+		// MDCT overlap with the previous frame
+		preroll = std::max(preroll, 1024);
+		break;
+	case AV_CODEC_ID_AC3:
+	case AV_CODEC_ID_EAC3:
+		preroll = std::max(preroll, 1536);
+		break;
+	case AV_CODEC_ID_MP2:
+	case AV_CODEC_ID_MP3:
+		// bit reservoir and MDCT overlap
+		preroll = std::max(preroll, 2304);
+		break;
+	case AV_CODEC_ID_VORBIS:
+		preroll = std::max(preroll, 2048);
+		break;
+	case AV_CODEC_ID_OPUS:
+		if (!preroll) {
+			preroll = m_pCodecCtx->sample_rate * 80 / 1000;
+		}
+		break;
+	default:
+		// unknown requirements, same as before the packet index
+		preroll = std::max(preroll, 4096);
+	}
+
+	return preroll;
+}
+
+int VDFFAudioSource::demux_read(AVPacket* pkt)
+{
+	if (m_hub) {
+		return m_hub->read_packet(m_streamIndex, pkt);
+	}
+	if (!reopen_demuxer()) {
+		return AVERROR(EIO);
+	}
+
+	while (1) {
+		int ret = av_read_frame(m_pFormatCtx, pkt);
+		if (ret < 0 || pkt->stream_index == m_streamIndex) {
+			return ret;
+		}
+		av_packet_unref(pkt);
+	}
+}
+
+void VDFFAudioSource::demux_seek(int64_t pos, int flags, bool force)
+{
+	if (m_hub) {
+		if (m_hub->seek(m_streamIndex, pos, flags, force)) {
+			return;
+		}
+		// other tracks are read elsewhere, continue with a private context
+		AVFormatContext* fmt = OpenAudioFile(m_pSource, m_streamIndex);
+		if (!fmt) {
+			m_hub->seek(m_streamIndex, pos, flags, true);
+			return;
 		}
+		DLog(L"VDFFAudioSource: stream {} leaves the shared demuxer", m_streamIndex);
+		m_hub->detach(m_streamIndex);
+		m_hub.reset();
+		m_pFormatCtx = fmt;
+		m_pStream = fmt->streams[m_streamIndex];
+	}
+	if (!reopen_demuxer()) {
+		return;
+	}
+
+	seek_frame(m_pFormatCtx, m_streamIndex, pos, flags);
+}
+
+void VDFFAudioSource::close_demuxer()
+{
+	if (m_hub) {
+		m_hub->detach(m_streamIndex);
+		m_hub.reset();
+		m_pFormatCtx = nullptr;
+	}
+	if (m_pFormatCtx) {
+		VDFFFilePool::close_input(&m_pFormatCtx);
 	}
+	m_pStream = nullptr;
+}
+
+bool VDFFAudioSource::reopen_demuxer()
+{
+	if (m_pFormatCtx) {
+		return true;
+	}
+	// the only track read from the segment, the shared demuxer is not needed
+	m_pFormatCtx = OpenAudioFile(m_pSource, m_streamIndex);
+	if (!m_pFormatCtx) {
+		return false;
+	}
+	m_pStream = m_pFormatCtx->streams[m_streamIndex];
+	DLog(L"VDFFAudioSource: reopened segment {}", m_pSource->m_path);
+
+	return true;
+}
+
+bool VDFFAudioSource::open_demuxer()
+{
+	std::lock_guard lock(m_decodeMutex);
+	return reopen_demuxer();
+}
+
+int VDFFAudioSource::decode_packet(AVPacket* pkt, ReadInfo& ri)
+{
+	int ret = demux_read(pkt);
+	if (ret == AVERROR(EAGAIN)) {
+		// the shared demuxer was moved by another track
+		next_sample = AV_NOPTS_VALUE;
+		return ret;
+	}
+	if (ret < 0) {
+		m_readAheadEof = true;
+		return ret;
+	}
+
+	if (pkt->pts != AV_NOPTS_VALUE) {
+		add_packet_index(pkt->pts);
+	}
+
+	m_perf.bytes_read += pkt->size;
+	auto pkt_data_orig = pkt->data;
+	auto pkt_size_orig = pkt->size;
+
+	ret = 0;
+	do {
+		int s = read_packet(pkt, ri);
+		if (s < 0) {
+			// a broken packet is skipped, no memory for the cache stops decoding
+			if (s == AVERROR(ENOMEM)) {
+				ret = s;
+			}
+			break;
+		}
+		pkt->data += s;
+		pkt->size -= s;
+	} while (pkt->size > 0);
+
+	pkt->data = pkt_data_orig;
+	pkt->size = pkt_size_orig;
+	av_packet_unref(pkt);
+
+	return ret;
+}
+
+bool VDFFAudioSource::read_ahead_pending()
+{
+	// continue only from where the host reads, the thread never seeks
+	return !m_readAheadEof
+		&& next_sample != AV_NOPTS_VALUE
+		&& next_sample + m_pCodecCtx->sample_rate >= m_readAheadFrom
+		&& next_sample < m_readAheadEnd
+		&& next_sample < sample_count;
+}
 
-	*lBytesRead = 0;
-	*lSamplesRead = 0;
-	return false;
+void VDFFAudioSource::read_ahead_thread()
+{
+	std::unique_ptr<AVPacket, std::function<void(AVPacket*)>> pkt{ av_packet_alloc(), [](AVPacket* p) { av_packet_free(&p); } };
+
+	std::unique_lock lock(m_decodeMutex);
+	while (1) {
+		// one packet per lock, Read() is served between packets
+		m_cvReadAhead.wait(lock, [this] { return m_readAheadStop || (!m_hostWaiting && read_ahead_pending()); });
+		if (m_readAheadStop) {
+			break;
+		}
+		ReadInfo ri;
+		if (decode_packet(pkt.get(), ri) == AVERROR(ENOMEM)) {
+			// the host reports it when it gets there
+			m_readAheadEof = true;
+		}
+	}
 }
 
 void VDFFAudioSource::write_silence(void* dst, uint32_t count)
@@ -556,10 +1018,9 @@ void VDFFAudioSource::insert_silence(int64_t start, uint32_t count)
 		int px = (int)(start / BufferPage::size);
 		int s0 = start % BufferPage::size;
 
-		if (px >= (int)buffer.size()) {
+		if (px >= (int)buffer.size() || !alloc_page(px)) {
 			break;
 		}
-		alloc_page(px);
 		BufferPage& bp = buffer[px];
 
 		int changed = 0;
@@ -585,24 +1046,7 @@ void VDFFAudioSource::invalidate(int64_t start, uint32_t count)
 		}
 		BufferPage& bp = buffer[px];
 		int n = s0 + count < BufferPage::size ? count : BufferPage::size - s0;
-		if (bp.a0 && s0 <= bp.a0) {
-			bp.a0 = 0;
-			bp.a1 = 0;
-			bp.b0 = 0;
-			bp.b1 = 0;
-		}
-		else if (s0 < bp.a1) {
-			bp.a1 = s0;
-			bp.b0 = 0;
-			bp.b1 = 0;
-		}
-		else if (bp.b0 && s0 <= bp.b0) {
-			bp.b0 = 0;
-			bp.b1 = 0;
-		}
-		else if (s0 < bp.b1) {
-			bp.b1 = s0;
-		}
+		bp.erase(s0, s0 + n);
 
 		start += n;
 		count -= n;
@@ -611,16 +1055,24 @@ void VDFFAudioSource::invalidate(int64_t start, uint32_t count)
 
 int VDFFAudioSource::read_packet(AVPacket* pkt, ReadInfo& ri)
 {
-	int ret = avcodec_send_packet(m_pCodecCtx, pkt);
+	int ret;
+	{
+		PerfTimer timer(m_perf.decode_time);
+		ret = avcodec_send_packet(m_pCodecCtx, pkt);
+	}
 	if (ret != 0) {
 		return -1;
 	}
 
 	while (1) {
-		ret = avcodec_receive_frame(m_pCodecCtx, m_pFrame);
+		{
+			PerfTimer timer(m_perf.decode_time);
+			ret = avcodec_receive_frame(m_pCodecCtx, m_pFrame);
+		}
 		if (ret != 0) {
 			break;
 		}
+		m_perf.decoded += m_pFrame->nb_samples;
 
 		ret = reset_swr();
 		if (ret < 0) {
@@ -648,6 +1100,7 @@ int VDFFAudioSource::read_packet(AVPacket* pkt, ReadInfo& ri)
 		// ignore samples to discard
 		// this is workaround for some defect with AAC decoding (maybe other format too)
 		if (discard_samples) {
+			m_perf.preroll_wasted += std::min(count, discard_samples);
 			if (count > discard_samples) {
 				int n = discard_samples;
 				discard_samples = 0;
@@ -704,22 +1157,25 @@ int VDFFAudioSource::read_packet(AVPacket* pkt, ReadInfo& ri)
 			}
 		}
 
+		if (m_predecodeSink && count) {
+			// whole track mode, no cache pages
+			convert_samples(m_predecodeSink + start * mRawFormat.Format.nBlockAlign, src_pos, count);
+			count = 0;
+		}
+
 		while (count) {
 			int px = (int)(start / BufferPage::size);
 			int s0 = start % BufferPage::size;
 
-			alloc_page(px);
+			if (!alloc_page(px)) {
+				return AVERROR(ENOMEM);
+			}
 			BufferPage& bp = buffer[px];
 
 			int changed = 0;
 			int n = bp.alloc(s0, count, changed);
 			if (changed) {
-				uint8_t* dst = bp.aud_data + s0 * mRawFormat.Format.nBlockAlign;
-				const uint8_t* src[32];
-				for (int i = 0; i < m_pFrame->ch_layout.nb_channels; i++) {
-					src[i] = m_pFrame->extended_data[i] + src_pos * src_linesize;
-				}
-				swr_convert(m_pSwrCtx, &dst, n, src, n);
+				convert_samples(bp.aud_data + s0 * mRawFormat.Format.nBlockAlign, src_pos, n);
 			}
 
 			src_pos += n;
@@ -739,176 +1195,338 @@ int VDFFAudioSource::read_packet(AVPacket* pkt, ReadInfo& ri)
 	return pkt->size;
 }
 
-void VDFFAudioSource::reset_cache()
+void VDFFAudioSource::convert_samples(uint8_t* dst, int src_pos, int count)
 {
-	for (auto& page : buffer) {
-		free(page.aud_data);
-		page = {};
+	const uint8_t* src[32];
+	for (int i = 0; i < m_pFrame->ch_layout.nb_channels; i++) {
+		src[i] = m_pFrame->extended_data[i] + src_pos * src_linesize;
 	}
 
-	first_page  = 0;
-	last_page   = 0;
-	used_pages  = 0;
-	next_sample = AV_NOPTS_VALUE;
+	PerfTimer timer(m_perf.convert_time);
+	switch (convert_mode) {
+	case convert_copy:
+		memcpy(dst, src[0], count * mRawFormat.Format.nBlockAlign);
+		break;
+	case convert_interleave:
+		if (InterleaveSamples(dst, src, m_pFrame->ch_layout.nb_channels, count, av_get_bytes_per_sample(out_fmt))) {
+			break;
+		}
+		[[fallthrough]];
+	default:
+		swr_convert(m_pSwrCtx, &dst, count, src, count);
+	}
 }
 
-void VDFFAudioSource::alloc_page(int i)
+VDFFAudioSource* VDFFAudioSource::open_private(uint64_t layout, AVSampleFormat fmt)
 {
-	BufferPage& bp = buffer[i];
-	if (bp.aud_data) {
-		return;
+	VDFFAudioSource* inner = new VDFFAudioSource(mContext);
+	inner->AddRef();
+	inner->m_privateInstance = true;
+	if (inner->initStream(m_pSource, m_streamIndex) < 0) {
+		inner->Release();
+		return nullptr;
 	}
+	inner->sample_count = sample_count;
+	inner->out_layout = layout;
+	inner->out_fmt = fmt;
+	inner->apply_output_format();
 
-	uint8_t* data = nullptr;
-
-	if (used_pages > used_pages_max) {
-		while (1) {
-			if (last_page > i) {
-				if (buffer[last_page].aud_data) {
-					if (data) {
-						break;
-					}
-					data = buffer[last_page].aud_data;
-					buffer[last_page] = {};
-					used_pages--;
-				}
-				last_page--;
-			}
-			else if (first_page < i) {
-				if (buffer[first_page].aud_data) {
-					if (data) {
-						break;
-					}
-					data = buffer[first_page].aud_data;
-					buffer[first_page] = {};
-					used_pages--;
-				}
-				first_page++;
-			}
-		}
+	return inner;
+}
+
+void VDFFAudioSource::start_predecode()
+{
+	m_predecode.reset();
+
+	// the whole track is mapped at once, 32-bit builds have not enough address space
+	if (!config_audio_predecode || sizeof(void*) < 8 || m_privateInstance || sample_count_estimated) {
+		return;
 	}
 
-	if (data) {
-		bp.aud_data = data;
-	} else {
-		bp.aud_data = (uint8_t*)malloc(BufferPage::size * mRawFormat.Format.nBlockAlign);
+	VDFFAudioSource* inner = open_private(out_layout, out_fmt);
+	if (!inner) {
+		return;
 	}
+	m_predecode.reset(VDFFAudioPredecode::Create(inner, sample_count, mRawFormat.Format.nBlockAlign, out_fmt == AV_SAMPLE_FMT_U8));
+}
+
+void VDFFAudioSource::predecode(uint8_t* data, std::atomic<int64_t>& ready, const std::atomic<bool>& stop)
+{
+	std::lock_guard lock(m_decodeMutex);
 
-	if (i < first_page) {
-		first_page = i;
+	m_predecodeSink = data;
+	init_start_time();
+	seek_to(0, 0);
+
+	std::unique_ptr<AVPacket, std::function<void(AVPacket*)>> pkt{ av_packet_alloc(), [](AVPacket* p) { av_packet_free(&p); } };
+
+	while (!stop) {
+		ReadInfo ri;
+		if (decode_packet(pkt.get(), ri) < 0) {
+			break;
+		}
+		if (next_sample != AV_NOPTS_VALUE && next_sample > ready) {
+			ready.store(std::min(next_sample, sample_count), std::memory_order_release);
+		}
 	}
-	if (i > last_page) {
-		last_page = i;
+	if (!stop) {
+		// the rest is silence, as with the cache
+		ready.store(sample_count, std::memory_order_release);
+		DLog(L"VDFFAudioSource: stream {} is decoded completely", m_streamIndex);
 	}
-	used_pages++;
+
+	m_predecodeSink = nullptr;
 }
 
-int VDFFAudioSource::BufferPage::copy(int s0, uint32_t count, void* dst, int sample_size)
+void VDFFAudioSource::GetPerfCounters(VDFFPerfCounters& counters)
 {
-	if (a0 <= s0 && a1 > s0) {
-		// copy from range a
-		int n = s0 + count < a1 ? count : a1 - s0;
-		memcpy(dst, aud_data + s0 * sample_size, n * sample_size);
-		return n;
+	std::lock_guard lock(m_decodeMutex);
+	PerfCountersFromTicks(counters, m_perf);
+}
+
+void VDFFAudioSource::ResetPerfCounters()
+{
+	std::lock_guard lock(m_decodeMutex);
+	m_perf = {};
+}
+
+int VDFFAudioSource::GetPerfCountersJson(char* buf, int buf_size)
+{
+	VDFFPerfCounters counters;
+	GetPerfCounters(counters);
+	return CopyJson(PerfCountersToJson(counters), buf, buf_size);
+}
+
+bool VDFFAudioSource::ComputePeaks()
+{
+	if (sample_count_estimated || !m_pCodecCtx) {
+		return false;
 	}
-	if (b0 <= s0 && b1 > s0) {
-		// copy from range b
-		int n = s0 + count < b1 ? count : b1 - s0;
-		memcpy(dst, aud_data + s0 * sample_size, n * sample_size);
-		return n;
+	if (!m_peaks) {
+		m_peaks = std::make_unique<VDFFAudioPeaks>(this, GetChannelLayout(m_pCodecCtx), sample_count);
 	}
-	return 0;
+	return m_peaks->compute();
+}
+
+int VDFFAudioSource::GetPeakChannels()
+{
+	return m_peaks ? m_peaks->get_channels() : 0;
 }
 
-int VDFFAudioSource::BufferPage::empty(int s0, uint32_t count)
+int VDFFAudioSource::GetPeakBinSize(int level)
 {
-	if (a0 <= s0 && a1 > s0) {
+	if (level < 0 || level >= VDFFAudioPeaks::level_count) {
 		return 0;
 	}
-	if (b0 <= s0 && b1 > s0) {
+	return VDFFAudioPeaks::bin_size[level];
+}
+
+int64_t VDFFAudioSource::GetPeakBinCount(int level)
+{
+	if (!m_peaks || !m_peaks->is_done() || level < 0 || level >= VDFFAudioPeaks::level_count) {
 		return 0;
 	}
-	if (a0 > s0) {
-		return s0 + count < a0 ? count : a0 - s0;
+	return m_peaks->get_bin_count(level);
+}
+
+int64_t VDFFAudioSource::GetPeaks(int level, int64_t first, int64_t count, VDFFPeak* dst)
+{
+	const int64_t bins = GetPeakBinCount(level);
+	if (first < 0 || first >= bins || count <= 0) {
+		return 0;
 	}
-	if (b0 > s0) {
-		return s0 + count < b0 ? count : b0 - s0;
+	count = std::min(count, bins - first);
+	const int channels = m_peaks->get_channels();
+	memcpy(dst, m_peaks->get_bins(level) + first * channels, (size_t)(count * channels) * sizeof(VDFFPeak));
+
+	return count;
+}
+
+void VDFFAudioSource::reset_cache()
+{
+	AudioCacheBudget::Instance().remove_all(this);
+	for (auto& page : buffer) {
+		free(page.aud_data);
+		page = {};
 	}
-	if (b1 <= s0) {
-		return s0 + count < size ? count : size - s0;
+
+	m_privatePages.clear();
+	m_cacheBytes = 0;
+	next_sample  = AV_NOPTS_VALUE;
+}
+
+// drops the cache and the decoder state of a segment that is not used
+void VDFFAudioSource::release()
+{
+	m_prewarmed = false;
+	std::lock_guard lock(m_decodeMutex);
+	if (!m_cacheBytes && next_sample == AV_NOPTS_VALUE) {
+		return;
+	}
+	m_readAheadEnd = m_readAheadFrom;
+	reset_cache();
+	avcodec_flush_buffers(m_pCodecCtx);
+	if (m_pSource->head_segment) {
+		// the index and the I/O buffers of the demuxer are not kept, packet_index is enough to seek
+		close_demuxer();
+		// the track is reopened with its own demuxer, the shared one is not used again
+		m_pSource->audio_hub.reset();
 	}
-	return 0;
 }
 
-int VDFFAudioSource::BufferPage::alloc(int s0, uint32_t count, int& changed)
+void VDFFAudioSource::release_idle_segments()
 {
-	int n = s0 + count < size ? count : size - s0;
-	if (a0 <= s0 && a1 >= s0 + n) {
-		// already in range a
-		changed = 0;
-		return n;
+	const uint64_t now = GetTickCount64();
+	m_lastAccess = now;
+
+	VDFFInputFile* f = m_pSource->head_segment ? m_pSource->head_segment : m_pSource;
+	VDFFAudioSource* head = f->audio_source;
+	if (config_segment_idle <= 0 || !f->next_segment || !head) {
+		return;
 	}
-	if (b0 <= s0 && b1 >= s0 + n) {
-		// already in range b
-		changed = 0;
-		return n;
+	// check once per second
+	if (now - head->m_lastIdleCheck < 1000) {
+		return;
 	}
+	head->m_lastIdleCheck = now;
 
-	changed = 1;
+	for (; f; f = f->next_segment) {
+		VDFFAudioSource* a = f->audio_source;
+		// signed, a segment pre-warmed meanwhile is newer than now
+		if (a && a != this && !a->m_deferred && int64_t(now - a->m_lastAccess) > int64_t(config_segment_idle) * 1000) {
+			a->release();
+		}
+	}
+}
 
-	if (a1 == 0) {
-		// empty page, just initialize
-		a0 = s0;
-		a1 = s0 + n;
-		return n;
+void VDFFAudioSource::prewarm_next(int64_t end)
+{
+	VDFFInputFile* next = m_pSource->next_segment;
+	if (!next || !next->audio_source || next->audio_source->m_prewarmed) {
+		return;
+	}
+	// about two seconds before the end
+	if (end + 2 * (int64_t)m_pCodecCtx->sample_rate < sample_count) {
+		return;
 	}
 
-	if (a0 <= s0 + n && a1 >= s0 + n) {
-		// extend range a down
-		a0 = s0;
-		return n;
+	VDFFAudioSource* a1 = next->audio_source;
+	a1->m_prewarmed = true;
+	m_pSource->prewarm_segment([a1] { a1->prewarm(); });
+}
+
+// seeks to the start and decodes the first second into the cache
+void VDFFAudioSource::prewarm()
+{
+	// the host repeats a failed attempt and gets the error
+	if (!init_deferred()) {
+		return;
 	}
+	std::unique_ptr<AVPacket, std::function<void(AVPacket*)>> pkt{ av_packet_alloc(), [](AVPacket* p) { av_packet_free(&p); } };
+	const int64_t end = std::min<int64_t>(m_pCodecCtx->sample_rate, sample_count);
 
-	if (a0 <= s0 && a1 >= s0) {
-		// extend range a up
-		a1 = s0 + n;
-		if (b0 && a1 >= b0) {
-			a1 = b1;
-			b0 = 0;
-			b1 = 0;
-		}
-		return n;
+	std::unique_lock lock(m_decodeMutex);
+	m_lastAccess = GetTickCount64();
+
+	if (m_predecode) {
+		return;
+	}
+	if (start_time == AV_NOPTS_VALUE) {
+		init_start_time();
+	}
+	if (next_sample != 0) {
+		seek_to(0, 0);
 	}
 
-	if (b0) {
-		if (b0 <= s0 + n && b1 >= s0 + n) {
-			// extend range b down
-			b0 = s0;
-			return n;
+	while (next_sample == AV_NOPTS_VALUE || next_sample < end) {
+		ReadInfo ri;
+		if (decode_packet(pkt.get(), ri) < 0) {
+			break;
 		}
-
-		if (b0 <= s0 && b1 >= s0) {
-			// extend range b up
-			b1 = s0 + n;
-			return n;
+		if (m_hostWaiting) {
+			// playback has reached this segment, the host continues by itself
+			break;
 		}
+	}
+}
 
-		// going to drop range b, possibly interesting for logging
-		changed = 2;
+void VDFFAudioSource::grow()
+{
+	const int64_t end_pts = m_pSource->get_end_pts(m_streamIndex);
+	if (end_pts == AV_NOPTS_VALUE) {
+		return;
 	}
 
-	if (a1 < s0) {
-		// insert after range a
-		b0 = s0;
-		b1 = s0 + n;
+	std::lock_guard lock(m_decodeMutex);
+	const int64_t start_pts = (m_pStream->start_time != AV_NOPTS_VALUE) ? m_pStream->start_time : 0;
+	const int64_t count = ((end_pts - start_pts) * time_base.num + time_base.den / 2) / time_base.den;
+	if (count <= sample_count) {
+		return;
 	}
-	else {
-		// insert before range a
-		b0 = a0;
-		b1 = a1;
-		a0 = s0;
-		a1 = s0 + n;
+	const int64_t old_count = sample_count;
+	sample_count = count;
+	m_streamInfo.mSampleCount = sample_count;
+
+	// cached pages stay, the budget refers to them by index
+	buffer.resize((size_t)((sample_count + BufferPage::size - 1) / BufferPage::size));
+	// covers the old length only
+	m_predecode.reset();
+
+	// the demuxer may have stopped at the old end, the next read seeks
+	if (m_hub) {
+		m_hub->update_size();
+	} else {
+		VDFFIOBackend::update_size(m_pFormatCtx->pb);
 	}
+	m_readAheadEof = false;
+	next_sample = AV_NOPTS_VALUE;
 
-	return n;
+	DLog(L"VDFFAudioSource: stream {} grown from {} to {} samples", m_streamIndex, old_count, sample_count);
+}
+
+bool VDFFAudioSource::alloc_page(int i)
+{
+	BufferPage& bp = buffer[i];
+	if (bp.aud_data) {
+		return true;
+	}
+
+	const size_t bytes = BufferPage::size * mRawFormat.Format.nBlockAlign;
+	if (m_privateInstance) {
+		// its owner reads every sample once, the pages would only push the pages of playback out of the budget
+		// the pages before the one being read are done, a packet may fill several pages after it
+		std::erase_if(m_privatePages, [this](int j) {
+			if (j < m_privateReadPage) {
+				drop_page(j);
+				return true;
+			}
+			return false;
+		});
+		bp.aud_data = (uint8_t*)malloc(bytes);
+		if (!bp.aud_data) {
+			return false;
+		}
+		m_privatePages.emplace_back(i);
+	} else {
+		// may evict older pages of this and other sources
+		bp.lru = AudioCacheBudget::Instance().add(this, i, bytes);
+		bp.aud_data = (uint8_t*)malloc(bytes);
+		if (!bp.aud_data) {
+			AudioCacheBudget::Instance().remove(bp.lru);
+			bp = {};
+			return false;
+		}
+	}
+
+	m_cacheBytes += bytes;
+	m_perf.cache_bytes_peak = std::max(m_perf.cache_bytes_peak, m_cacheBytes);
+	return true;
+}
+
+void VDFFAudioSource::drop_page(int i)
+{
+	BufferPage& bp = buffer[i];
+	free(bp.aud_data);
+	bp = {};
+	m_cacheBytes -= BufferPage::size * mRawFormat.Format.nBlockAlign;
 }
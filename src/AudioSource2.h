@@ -10,8 +10,17 @@
 #include <vd2/plugin/vdinputdriver.h>
 #include <vd2/VDXFrame/Unknown.h>
 #include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
 #include <mmreg.h>
 #include "stdint.h"
+#include "PerfCounters.h"
+#include "AudioCache.h"
+#include "AudioBufferPage.h"
+#include "AudioPeaks.h"
 
 extern "C"
 {
@@ -23,9 +32,14 @@ extern "C"
 }
 
 class VDFFInputFile;
+class VDFFDemuxHub;
+class VDFFAudioPredecode;
 
-class VDFFAudioSource : public vdxunknown<IVDXStreamSource>, public IVDXAudioSource
+class VDFFAudioSource : public vdxunknown<IVDXStreamSource>, public IVDXAudioSource, public IVDFFPerfCounters, public IVDFFAudioPeaks
 {
+	friend class AudioCacheBudget;
+	friend class VDFFAudioPeaks;
+
 public:
 	VDFFAudioSource(const VDXInputDriverContext& context);
 	~VDFFAudioSource();
@@ -51,6 +65,16 @@ public:
 
 	void VDXAPIENTRY GetAudioSourceInfo(VDXAudioSourceInfo& info) override { info.mFlags = 0; }
 
+	void VDXAPIENTRY GetPerfCounters(VDFFPerfCounters& counters) override;
+	void VDXAPIENTRY ResetPerfCounters() override;
+	int  VDXAPIENTRY GetPerfCountersJson(char* buf, int buf_size) override;
+
+	bool    VDXAPIENTRY ComputePeaks() override;
+	int     VDXAPIENTRY GetPeakChannels() override;
+	int     VDXAPIENTRY GetPeakBinSize(int level) override;
+	int64_t VDXAPIENTRY GetPeakBinCount(int level) override;
+	int64_t VDXAPIENTRY GetPeaks(int level, int64_t first, int64_t count, VDFFPeak* dst) override;
+
 private:
 	const VDXInputDriverContext& mContext;
 	WAVEFORMATEXTENSIBLE mRawFormat = {};
@@ -60,7 +84,15 @@ private:
 	int64_t start_time   = 0;
 	int64_t time_adjust  = 0;
 
-	AVFormatContext* m_pFormatCtx = nullptr;
+	AVFormatContext* m_pFormatCtx = nullptr; // owned by m_hub if it is set
+	std::shared_ptr<VDFFDemuxHub> m_hub;
+	int64_t first_pts = AV_NOPTS_VALUE;
+
+	std::unique_ptr<VDFFAudioPredecode> m_predecode;
+	std::unique_ptr<VDFFAudioPeaks> m_peaks;
+	uint8_t* m_predecodeSink = nullptr; // the private instance of VDFFAudioPredecode writes here
+	bool m_privateInstance = false; // background work of another instance, no hub, no predecode
+	bool sample_count_estimated = false;
 public:
 	AVStream*       m_pStream   = nullptr;
 	AVCodecContext* m_pCodecCtx = nullptr;
@@ -76,24 +108,20 @@ private:
 	uint64_t swr_layout    = 0;
 	int swr_rate           = 0;
 	AVSampleFormat swr_fmt = AV_SAMPLE_FMT_NONE;
-
-	struct BufferPage {
-		enum { size = 0x8000 }; // max usable value 0xFFFF
-
-		uint16_t a0 = 0, a1 = 0; // range a
-		uint16_t b0 = 0, b1 = 0; // range b
-		uint8_t* aud_data = nullptr;
-
-		int copy(int s0, uint32_t count, void* dst, int sample_size);
-		int alloc(int s0, uint32_t count, int& changed);
-		int empty(int s0, uint32_t count);
+	enum ConvertMode {
+		convert_swr,
+		convert_copy,       // same format and layout
+		convert_interleave, // planar to packed, same layout
+	} convert_mode = convert_swr;
+
+	struct BufferPage : AudioBufferPage {
+		AudioCacheBudget::Handle lru; // valid if aud_data is allocated
 	};
 
 	std::vector<BufferPage> buffer;
-	int used_pages     = 0;
-	int used_pages_max = 0;
-	int first_page     = 0;
-	int last_page      = 0;
+	int64_t m_cacheBytes = 0; // pages are limited by AudioCacheBudget
+	std::deque<int> m_privatePages; // a private instance keeps only the pages from the one being read on
+	int m_privateReadPage = 0;
 
 	int64_t next_sample  = 0;
 	int64_t first_sample = AV_NOPTS_VALUE;
@@ -101,6 +129,31 @@ private:
 	bool trust_sample_pos = false;;
 	bool use_keys = false;
 
+	std::vector<int64_t> packet_index; // sorted pts of known packet boundaries
+	int preroll_samples = 0;
+
+	VDFFPerfCounters m_perf; // times in ticks
+
+	// the read-ahead thread decodes ahead of the last Read() position,
+	// the decoder, the demuxer and the cache are shared under m_decodeMutex
+	std::thread m_readAheadThread;
+	std::mutex m_decodeMutex;
+	std::condition_variable m_cvReadAhead;
+	std::atomic<int> m_hostWaiting = 0;
+	int64_t m_readAheadFrom = 0;
+	int64_t m_readAheadEnd  = 0;
+	bool m_readAheadEof  = false;
+	bool m_readAheadStop = false;
+
+	// GetTickCount64() of the last Read, pre-warming sets it on another thread
+	std::atomic<uint64_t> m_lastAccess = 0;
+	uint64_t m_lastIdleCheck = 0; // head segment only
+	std::atomic<bool> m_prewarmed = false; // the start of the segment was decoded ahead of playback
+	int  m_growth    = 0;         // the last growth of the file handled by grow()
+	// appended segment whose stream is not opened yet, see init_deferred
+	std::atomic<bool> m_deferred = false;
+	std::mutex m_initMutex;
+
 	struct ReadInfo {
 		int64_t first_sample = -1;
 		int64_t last_sample  = -1;
@@ -108,15 +161,54 @@ private:
 
 public:
 	int initStream(VDFFInputFile* pSource, int streamIndex);
-	AVFormatContext* OpenAudioFile(std::wstring_view path, int streamIndex);
+	// appended segment, only the sample count is taken from the header or the tail scan
+	int initSegment(VDFFInputFile* pSource, int streamIndex);
+	// runs initStream of a segment on first access, the sample count stays as reported to the host
+	bool init_deferred();
+	bool is_deferred() const { return m_deferred; }
+	// opens the demuxer again if release() has closed it, m_pStream is valid after that
+	bool open_demuxer();
+	// decodes the whole stream into data, called by VDFFAudioPredecode on its thread
+	void predecode(uint8_t* data, std::atomic<int64_t>& ready, const std::atomic<bool>& stop);
+	AVFormatContext* OpenAudioFile(VDFFInputFile* pSource, int streamIndex);
 private:
+	// sets time_base and sample_count from the stream of fmt
+	void init_duration(const AVFormatContext* fmt, const AVStream* st);
 	void init_start_time();
+	bool read_samples(int64_t start, uint32_t count, void* lpBuffer, uint32_t cbBuffer, uint32_t* lBytesRead, uint32_t* lSamplesRead);
+	// one contiguous range within a page, returns the number of samples
+	int read_block(int64_t start, uint32_t count, uint8_t* dst);
+	int demux_read(AVPacket* pkt);
+	void demux_seek(int64_t pos, int flags, bool force);
+	void close_demuxer();
+	// a released segment opens a private context at its next read
+	bool reopen_demuxer();
+	int decode_packet(AVPacket* pkt, ReadInfo& ri);
+	void seek_to(int64_t start, int backoff);
+	int64_t find_seek_pts(int64_t sample);
+	void add_packet_index(int64_t pts);
+	int get_preroll();
 	int read_packet(AVPacket* pkt, ReadInfo& ri);
+	void convert_samples(uint8_t* dst, int src_pos, int count);
+	void apply_output_format();
+	void start_predecode();
+	// a separate instance with its own demuxer and cache, the caller releases it
+	VDFFAudioSource* open_private(uint64_t layout, AVSampleFormat fmt);
+	bool read_ahead_pending();
+	void read_ahead_thread();
 	void insert_silence(int64_t start, uint32_t count);
 	void write_silence(void* dst, uint32_t count);
 	void invalidate(int64_t start, uint32_t count);
-	void alloc_page(int i);
+	bool alloc_page(int i);
+	void drop_page(int i);
 	void reset_cache();
+	void release();
+	void release_idle_segments();
+	// starts pre-warming of the next segment when playback is near the end of this one
+	void prewarm_next(int64_t end);
+	void prewarm();
+	// extends sample_count and the cache pages after the file has grown
+	void grow();
 	int reset_swr();
 	int64_t frame_to_pts(int64_t start, AVStream* video);
 };
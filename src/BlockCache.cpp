@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2026 v0lt
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "stdafx.h"
+
+#include "BlockCache.h"
+#include "Helper.h"
+
+extern int config_io_cache_size;
+
+VDFFBlockCache& VDFFBlockCache::Instance()
+{
+	static VDFFBlockCache cache;
+	return cache;
+}
+
+VDFFBlockCache::VDFFBlockCache()
+{
+	MEMORYSTATUSEX ms = { sizeof(MEMORYSTATUSEX) };
+	GlobalMemoryStatusEx(&ms);
+
+	m_limit = (uint64_t)config_io_cache_size * 1024 * 1024;
+	// do not take more than a quarter of physical memory
+	m_limit = std::min(m_limit, (uint64_t)ms.ullTotalPhys / 4);
+#ifndef _WIN64
+	m_limit = std::min(m_limit, (uint64_t)256 * 1024 * 1024);
+#endif
+	// a few blocks for every context
+	m_limit = std::max(m_limit, (uint64_t)16 * block_size);
+
+	DLog(L"VDFFBlockCache: {} MB", m_limit / (1024 * 1024));
+}
+
+std::wstring VDFFBlockCache::make_key(const std::wstring& path, HANDLE handle)
+{
+	BY_HANDLE_FILE_INFORMATION info = {};
+	GetFileInformationByHandle(handle, &info);
+	const uint64_t size = ((uint64_t)info.nFileSizeHigh << 32) | info.nFileSizeLow;
+	const uint64_t time = ((uint64_t)info.ftLastWriteTime.dwHighDateTime << 32) | info.ftLastWriteTime.dwLowDateTime;
+
+	return std::format(L"{}|{}|{}", path, size, time);
+}
+
+int VDFFBlockCache::read(const std::wstring& key, int64_t pos, uint8_t* buf, int size, const ReadFunc& read_block)
+{
+	const Key k(key, pos / block_size);
+	std::shared_ptr<Block> block;
+
+	std::unique_lock lock(m_mutex);
+	auto it = m_blocks.find(k);
+	if (it != m_blocks.end()) {
+		block = it->second;
+		// another context may be reading it
+		m_cvReady.wait(lock, [&] { return block->ready; });
+		if (block->listed) {
+			m_lru.splice(m_lru.begin(), m_lru, block->lru);
+		}
+	} else {
+		block = std::make_shared<Block>();
+		m_blocks.emplace(k, block);
+		lock.unlock();
+
+		block->data.resize(block_size);
+		DWORD n = 0;
+		if (read_block(k.second * block_size, block->data.data(), block_size, n)) {
+			block->data.resize(n);
+			block->data.shrink_to_fit();
+		} else {
+			block->failed = true;
+		}
+
+		lock.lock();
+		block->ready = true;
+		if (block->failed) {
+			m_blocks.erase(k);
+		} else {
+			m_lru.emplace_front(k);
+			block->lru = m_lru.begin();
+			block->listed = true;
+			m_bytes += block->data.size();
+
+			// blocks in use by a reader are kept alive by their shared_ptr
+			while (m_bytes > m_limit && m_lru.size() > 1) {
+				auto victim = m_blocks.find(m_lru.back());
+				m_bytes -= victim->second->data.size();
+				victim->second->listed = false;
+				m_blocks.erase(victim);
+				m_lru.pop_back();
+			}
+		}
+		m_cvReady.notify_all();
+	}
+	lock.unlock();
+
+	if (block->failed) {
+		return -1;
+	}
+	const int64_t offset = pos - k.second * block_size;
+	const int n = (int)std::min<int64_t>(size, (int64_t)block->data.size() - offset);
+	if (n <= 0) {
+		return 0;
+	}
+	memcpy(buf, block->data.data() + offset, n);
+
+	return n;
+}
@@ -0,0 +1,57 @@
+/*
+ * Copyright (C) 2026 v0lt
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Blocks of input files shared by all contexts that read the same file
+// (video, audio tracks, export, fflayer), so every block is fetched once.
+// When the size limit is exceeded, blocks are evicted in least recently used order.
+class VDFFBlockCache
+{
+public:
+	static constexpr int block_size = 1024 * 1024;
+
+	// reads a whole block from the file, done is less than size at the end of the file
+	using ReadFunc = std::function<bool(int64_t pos, uint8_t* buf, DWORD size, DWORD& done)>;
+
+	static VDFFBlockCache& Instance();
+
+	// key identifies the file version, see make_key
+	// copies up to size bytes at pos, the block is read with read_block if it is not cached
+	// returns the number of bytes, 0 at the end of the file, -1 on a read error
+	int read(const std::wstring& key, int64_t pos, uint8_t* buf, int size, const ReadFunc& read_block);
+
+	// path, size and write time, a changed file does not get stale blocks
+	static std::wstring make_key(const std::wstring& path, HANDLE handle);
+
+private:
+	VDFFBlockCache();
+
+	struct Block {
+		std::vector<uint8_t> data;
+		bool ready  = false; // being read otherwise
+		bool failed = false;
+		bool listed = false;
+		std::list<std::pair<std::wstring, int64_t>>::iterator lru;
+	};
+	using Key = std::pair<std::wstring, int64_t>; // file, block index
+
+	std::mutex m_mutex;
+	std::condition_variable m_cvReady;
+	std::map<Key, std::shared_ptr<Block>> m_blocks;
+	std::list<Key> m_lru; // ready blocks, most recently used first
+	uint64_t m_bytes = 0;
+	uint64_t m_limit = 0;
+};
@@ -0,0 +1,205 @@
+/*
+ * Copyright (C) 2026 v0lt
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "stdafx.h"
+
+#include "DemuxHub.h"
+#include "InputFile2.h"
+#include "FilePool.h"
+#include "ProbeCache.h"
+#include "IOBackend.h"
+#include "Utils/StringUtil.h"
+#include "Helper.h"
+
+// a stream that lags this much behind the others is considered diverged
+const size_t max_queue_bytes = 64 * 1024 * 1024;
+
+VDFFDemuxHub* VDFFDemuxHub::Open(std::wstring_view path, bool pooled, const AVFormatContext* probed)
+{
+	const AVInputFormat* iformat = probed ? probed->iformat : nullptr;
+
+	AVFormatContext* fmt = nullptr;
+	int err = pooled
+		? VDFFFilePool::Instance().open_input(&fmt, std::wstring(path), iformat)
+		: VDFFIOBackend::open_input(&fmt, std::wstring(path), iformat);
+	if (err < 0) {
+		DLog(L"VDFFDemuxHub: open failure");
+		return nullptr;
+	}
+
+	err = VDFFProbeCache::find_stream_info(fmt, probed);
+	if (err < 0) {
+		DLog(L"VDFFDemuxHub: couldn't find stream information");
+		VDFFFilePool::close_input(&fmt);
+		return nullptr;
+	}
+
+	// streams are enabled when attached
+	for (int i = 0; i < (int)fmt->nb_streams; i++) {
+		fmt->streams[i]->discard = AVDISCARD_ALL;
+	}
+
+	return new VDFFDemuxHub(fmt);
+}
+
+VDFFDemuxHub::VDFFDemuxHub(AVFormatContext* fmt)
+	: m_pFormatCtx(fmt)
+	, m_streams(fmt->nb_streams)
+{
+}
+
+VDFFDemuxHub::~VDFFDemuxHub()
+{
+	for (auto& s : m_streams) {
+		flush(s);
+	}
+	VDFFFilePool::close_input(&m_pFormatCtx);
+}
+
+void VDFFDemuxHub::flush(Stream& s)
+{
+	for (auto& pkt : s.queue) {
+		av_packet_free(&pkt);
+	}
+	s.queue.clear();
+	s.bytes = 0;
+}
+
+bool VDFFDemuxHub::attach(int stream)
+{
+	std::lock_guard lock(m_mutex);
+
+	Stream& s = m_streams[stream];
+	if (s.attached) {
+		return false;
+	}
+	s = {};
+	s.attached = true;
+	// nothing is queued until the source seeks
+	s.fresh = false;
+	s.reset = true;
+	m_pFormatCtx->streams[stream]->discard = AVDISCARD_DEFAULT;
+
+	return true;
+}
+
+void VDFFDemuxHub::detach(int stream)
+{
+	std::lock_guard lock(m_mutex);
+
+	Stream& s = m_streams[stream];
+	flush(s);
+	s.attached = false;
+	m_pFormatCtx->streams[stream]->discard = AVDISCARD_ALL;
+}
+
+int VDFFDemuxHub::read_packet(int stream, AVPacket* pkt)
+{
+	std::lock_guard lock(m_mutex);
+
+	Stream& s = m_streams[stream];
+	if (s.reset) {
+		s.reset = false;
+		return AVERROR(EAGAIN);
+	}
+	s.fresh = false;
+
+	if (s.queue.size()) {
+		AVPacket* p = s.queue.front();
+		s.queue.pop_front();
+		s.bytes -= p->size;
+		av_packet_move_ref(pkt, p);
+		av_packet_free(&p);
+		return 0;
+	}
+
+	while (1) {
+		int ret = av_read_frame(m_pFormatCtx, pkt);
+		if (ret < 0) {
+			return ret;
+		}
+		if (pkt->stream_index == stream) {
+			return 0;
+		}
+
+		Stream& other = m_streams[pkt->stream_index];
+		// a moved stream will seek to nearly the same time, keep its packets
+		if (other.attached && (!other.reset || other.fresh)) {
+			if (other.bytes + pkt->size > max_queue_bytes) {
+				// the stream does not follow, let it seek and leave the hub
+				flush(other);
+				other.fresh = false;
+				other.reset = true;
+				other.displaced = true;
+			} else {
+				AVPacket* p = av_packet_alloc();
+				av_packet_move_ref(p, pkt);
+				other.queue.emplace_back(p);
+				other.bytes += p->size;
+			}
+		}
+		av_packet_unref(pkt);
+	}
+}
+
+bool VDFFDemuxHub::seek(int stream, int64_t timestamp, int flags, bool force)
+{
+	std::lock_guard lock(m_mutex);
+
+	Stream& s = m_streams[stream];
+	const bool displaced = s.displaced;
+	s.displaced = false;
+	s.reset = false;
+
+	int64_t time = AV_NOPTS_VALUE;
+	if (timestamp != AV_SEEK_START) {
+		time = av_rescale_q(timestamp, m_pFormatCtx->streams[stream]->time_base, AV_TIME_BASE_Q);
+	}
+
+	if (!force && s.fresh) {
+		// the demuxer has just been moved near this time, use the queued packets
+		bool near;
+		if (m_seekTime == AV_NOPTS_VALUE) {
+			near = (time == AV_NOPTS_VALUE || time < AV_TIME_BASE);
+		} else {
+			near = (time != AV_NOPTS_VALUE && time >= m_seekTime && time - m_seekTime < AV_TIME_BASE);
+		}
+		if (near) {
+			return true;
+		}
+	}
+
+	if (!force && displaced) {
+		// two streams want different positions
+		return false;
+	}
+
+	seek_frame(m_pFormatCtx, stream, timestamp, flags);
+	m_seekTime = time;
+
+	for (int i = 0; i < (int)m_streams.size(); i++) {
+		Stream& other = m_streams[i];
+		if (!other.attached) {
+			continue;
+		}
+		flush(other);
+		if (i != stream) {
+			if (!other.fresh) {
+				other.displaced = true;
+			}
+			other.reset = true;
+		}
+		other.fresh = true;
+	}
+
+	return true;
+}
+
+void VDFFDemuxHub::update_size()
+{
+	std::lock_guard lock(m_mutex);
+	VDFFIOBackend::update_size(m_pFormatCtx->pb);
+}
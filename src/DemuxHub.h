@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2026 v0lt
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+
+#include <deque>
+#include <vector>
+#include <mutex>
+#include <string_view>
+
+extern "C"
+{
+#include <libavformat/avformat.h>
+}
+
+// One demuxer shared by the audio sources of a file.
+// Each packet is read once and queued for the attached stream it belongs to,
+// so a linear render of N audio tracks reads the file once instead of N times.
+// The hub follows the stream that seeks. Other streams may seek to nearly the same time
+// without moving the demuxer again. A stream that reads somewhere else is
+// reported as diverged, and its source continues with a private context.
+class VDFFDemuxHub
+{
+public:
+	// pooled: the file handle is managed by VDFFFilePool
+	// probed: a context of the same file whose stream information is reused, may be nullptr
+	static VDFFDemuxHub* Open(std::wstring_view path, bool pooled, const AVFormatContext* probed);
+	~VDFFDemuxHub();
+
+	// for stream information only, reading and seeking go through the hub
+	AVFormatContext* get_context() { return m_pFormatCtx; }
+
+	// returns false if the stream already has a consumer
+	bool attach(int stream);
+	void detach(int stream);
+
+	// next packet of the stream
+	// returns AVERROR(EAGAIN) once after the demuxer was moved by another stream
+	int read_packet(int stream, AVPacket* pkt);
+	// returns false if the stream diverged from the others and should use a private context
+	// force moves the demuxer in any case
+	bool seek(int stream, int64_t timestamp, int flags, bool force);
+	// the file has grown
+	void update_size();
+
+private:
+	VDFFDemuxHub(AVFormatContext* fmt);
+
+	struct Stream {
+		bool attached  = false;
+		bool fresh     = true;  // nothing read since the demuxer was moved
+		bool reset     = false; // the demuxer was moved by another stream
+		bool displaced = false; // same, while the stream was reading
+		size_t bytes   = 0;
+		std::deque<AVPacket*> queue;
+	};
+
+	std::mutex m_mutex;
+	AVFormatContext* m_pFormatCtx = nullptr;
+	std::vector<Stream> m_streams;
+	int64_t m_seekTime = AV_NOPTS_VALUE; // AV_TIME_BASE units, AV_NOPTS_VALUE means the start
+
+	void flush(Stream& s);
+};
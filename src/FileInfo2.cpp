@@ -9,6 +9,7 @@
 
 #include "FileInfo2.h"
 #include "InputFile2.h"
+#include "ImageSequence.h"
 #include "VideoSource2.h"
 #include "AudioSource2.h"
 #include "resource.h"
@@ -62,6 +63,15 @@ void VDFFInputFileInfoDialog::load_segment()
 	}
 
 	segment = f;
+	// the details of an appended segment need its decoder and its demuxer, an idle one has closed it
+	if (segment->video_source) {
+		segment->video_source->init_deferred();
+		segment->video_source->open_demuxer();
+	}
+	if (segment->audio_source) {
+		segment->audio_source->init_deferred();
+		segment->audio_source->open_demuxer();
+	}
 
 	const wchar_t* p0 = wcsrchr(segment->m_path.c_str(), '\\');
 	const wchar_t* p1 = wcsrchr(segment->m_path.c_str(), '/');
@@ -141,6 +151,10 @@ INT_PTR VDFFInputFileInfoDialog::DlgProc(UINT msg, WPARAM wParam, LPARAM lParam)
 			}
 			return TRUE;
 
+		case IDC_COPY_STATS:
+			copy_stats();
+			return TRUE;
+
 		}
 	}
 
@@ -150,6 +164,10 @@ INT_PTR VDFFInputFileInfoDialog::DlgProc(UINT msg, WPARAM wParam, LPARAM lParam)
 void VDFFInputFileInfoDialog::print_format()
 {
 	AVFormatContext* pFormatCtx = segment->getContext();
+	if (!pFormatCtx) {
+		// the demuxer of the segment could not be opened again
+		return;
+	}
 	const AVInputFormat* pInputFormat = pFormatCtx->iformat;
 
 	SetDlgItemTextA(mhdlg, IDC_STATICVerNumber, vsnstr);
@@ -161,6 +179,9 @@ void VDFFInputFileInfoDialog::print_format()
 		int n = segment->video_source->m_sample_count;
 		if (n > 1) {
 			str = std::format(L"{} images", n);
+			if (segment->image_sequence && segment->image_sequence->get_missing_count()) {
+				str += std::format(L" ({} missing)", segment->image_sequence->get_missing_count());
+			}
 			SetDlgItemTextW(mhdlg, IDC_DURATION, str.c_str());
 		}
 		else {
@@ -204,10 +225,10 @@ void VDFFInputFileInfoDialog::print_format()
 void VDFFInputFileInfoDialog::print_video()
 {
 	AVCodecContext* pVideoCtx = segment->video_source->m_pCodecCtx;
-	if (!pVideoCtx) {
+	AVStream* pVideoStream = segment->video_source->m_pStream;
+	if (!pVideoCtx || !pVideoStream) {
 		return;
 	}
-	AVStream* pVideoStream = segment->video_source->m_pStream;
 	AVCodecParameters* codecpar = pVideoStream->codecpar;
 
 
@@ -445,9 +466,15 @@ void VDFFInputFileInfoDialog::print_performance()
 	int decoded_count = 0;
 	bool all_key = true;
 	bool has_vfr = false;
+	VDFFPerfCounters perf;
 
 	while (f1 && f1->video_source) {
 		VDFFVideoSource* v1 = f1->video_source;
+		if (v1->is_deferred()) {
+			// not opened yet, nothing to show
+			f1 = f1->next_segment;
+			continue;
+		}
 		buf_max += v1->buffer_reserve;
 		for (size_t i = 0; i < v1->buffer.size(); i++) {
 			if (v1->buffer[i].refs) {
@@ -465,6 +492,13 @@ void VDFFInputFileInfoDialog::print_performance()
 		if (v1->has_vfr) has_vfr = true;
 		decoded_count += v1->decoded_count;
 
+		VDFFPerfCounters c;
+		v1->GetPerfCounters(c);
+		perf.delivered    += c.delivered;
+		perf.cache_hits   += c.cache_hits;
+		perf.cache_misses += c.cache_misses;
+		perf.seeks        += c.seeks;
+
 		f1 = f1->next_segment;
 	}
 
@@ -489,11 +523,20 @@ void VDFFInputFileInfoDialog::print_performance()
 	str = std::format(L"Memory cache: {} frames / {}M reserved, {}% used", buf_max, mem_max, buf_used);
 	SetDlgItemTextW(mhdlg, IDC_MEMORY_INFO, str.c_str());
 
-	str = std::format(L"Frames decoded: {}", decoded_count);
+	str = std::format(L"Frames decoded: {}, delivered: {}", decoded_count, perf.delivered);
+	const int64_t requests = perf.cache_hits + perf.cache_misses;
+	if (requests) {
+		str += std::format(L", cache hits: {}%, seeks: {}", perf.cache_hits * 100 / requests, perf.seeks);
+	}
 	SetDlgItemTextW(mhdlg, IDC_STATS, str.c_str());
 
 	if (segment->is_image) {
-		SetDlgItemTextW(mhdlg, IDC_INDEX_INFO, L"Seeking: image list (random access)");
+		if (segment->image_sequence) {
+			str = std::format(L"Seeking: image list (random access), {} decoding threads", segment->image_sequence->get_thread_count());
+			SetDlgItemTextW(mhdlg, IDC_INDEX_INFO, str.c_str());
+		} else {
+			SetDlgItemTextW(mhdlg, IDC_INDEX_INFO, L"Seeking: image list (random access)");
+		}
 	}
 	else {
 		std::wstring msg;
@@ -519,3 +562,44 @@ void VDFFInputFileInfoDialog::print_performance()
 		SetDlgItemTextW(mhdlg, IDC_INDEX_INFO, msg.c_str());
 	}
 }
+
+void VDFFInputFileInfoDialog::copy_stats()
+{
+	std::string json = "{\"segments\":[";
+
+	for (VDFFInputFile* f1 = source; f1; f1 = f1->next_segment) {
+		if (f1 != source) {
+			json += ',';
+		}
+		json += '{';
+		if (f1->video_source) {
+			VDFFPerfCounters c;
+			f1->video_source->GetPerfCounters(c);
+			json += "\"video\":" + PerfCountersToJson(c);
+		}
+		if (f1->audio_source) {
+			VDFFPerfCounters c;
+			f1->audio_source->GetPerfCounters(c);
+			if (f1->video_source) {
+				json += ',';
+			}
+			json += "\"audio\":" + PerfCountersToJson(c);
+		}
+		json += '}';
+	}
+	json += "]}";
+
+	if (!OpenClipboard(mhdlg)) {
+		return;
+	}
+	EmptyClipboard();
+	HGLOBAL hMem = GlobalAlloc(GMEM_MOVEABLE, json.size() + 1);
+	if (hMem) {
+		memcpy(GlobalLock(hMem), json.c_str(), json.size() + 1);
+		GlobalUnlock(hMem);
+		if (!SetClipboardData(CF_TEXT, hMem)) {
+			GlobalFree(hMem);
+		}
+	}
+	CloseClipboard();
+}
@@ -39,4 +39,5 @@ private:
 	void print_audio();
 	void print_metadata();
 	void print_performance();
+	void copy_stats();
 };
@@ -0,0 +1,174 @@
+/*
+ * Copyright (C) 2026 v0lt
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "stdafx.h"
+
+#include "FilePool.h"
+#include "IOBackend.h"
+#include "Utils/StringUtil.h"
+#include "Helper.h"
+
+extern int config_segment_open;
+
+VDFFFilePool& VDFFFilePool::Instance()
+{
+	static VDFFFilePool pool;
+	return pool;
+}
+
+int VDFFFilePool::open_input(AVFormatContext** ps, const std::wstring& path, const AVInputFormat* iformat)
+{
+	File* f = new File;
+	f->path = path;
+	if (!acquire(f)) {
+		delete f;
+		return AVERROR(ENOENT);
+	}
+	LARGE_INTEGER size;
+	if (GetFileSizeEx(f->handle, &size)) {
+		f->size = size.QuadPart;
+	}
+	f->mutex.unlock();
+
+	const int io_size = 64 * 1024;
+	uint8_t* io_buf = (uint8_t*)av_malloc(io_size);
+	AVIOContext* pb = avio_alloc_context(io_buf, io_size, 0, f, &Read, nullptr, &Seek);
+
+	AVFormatContext* fmt = avformat_alloc_context();
+	fmt->pb = pb;
+	fmt->flags |= AVFMT_FLAG_CUSTOM_IO;
+
+	std::string ff_path = ConvertWideToUtf8(path);
+	int err = avformat_open_input(&fmt, ff_path.c_str(), iformat, nullptr);
+	if (err < 0) {
+		// fmt is freed by avformat_open_input, the custom context is not
+		remove(f);
+		av_freep(&pb->buffer);
+		avio_context_free(&pb);
+		return err;
+	}
+
+	*ps = fmt;
+	return 0;
+}
+
+void VDFFFilePool::close_input(AVFormatContext** ps)
+{
+	if (!*ps) {
+		return;
+	}
+	AVIOContext* pb = ((*ps)->flags & AVFMT_FLAG_CUSTOM_IO) ? (*ps)->pb : nullptr;
+
+	avformat_close_input(ps);
+
+	if (!pb) {
+		return;
+	}
+	if (pb->read_packet == &Read) {
+		Instance().remove((File*)pb->opaque);
+		av_freep(&pb->buffer);
+		avio_context_free(&pb);
+	} else {
+		VDFFIOBackend::free_context(pb);
+	}
+}
+
+// opens the handle if needed and returns with f->mutex locked
+bool VDFFFilePool::acquire(File* f)
+{
+	f->mutex.lock();
+
+	std::lock_guard lock(m_mutex);
+	if (f->handle != INVALID_HANDLE_VALUE) {
+		m_open.splice(m_open.begin(), m_open, f->lru);
+		return true;
+	}
+
+	f->handle = CreateFileW(f->path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (f->handle == INVALID_HANDLE_VALUE) {
+		f->mutex.unlock();
+		return false;
+	}
+	m_open.emplace_front(f);
+	f->lru = m_open.begin();
+	f->listed = true;
+
+	// a segment has a few files open: video, shared audio demuxer, audio instances
+	const size_t limit = (size_t)std::max(config_segment_open, 1) * 4;
+	auto it = m_open.end();
+	while (m_open.size() > limit && it != m_open.begin()) {
+		--it;
+		File* victim = *it;
+		// a file that is being read stays open
+		if (victim == f || !victim->mutex.try_lock()) {
+			continue;
+		}
+		CloseHandle(victim->handle);
+		victim->handle = INVALID_HANDLE_VALUE;
+		victim->listed = false;
+		victim->mutex.unlock();
+		it = m_open.erase(it);
+	}
+
+	return true;
+}
+
+void VDFFFilePool::remove(File* f)
+{
+	{
+		std::lock_guard lock(m_mutex);
+		if (f->listed) {
+			m_open.erase(f->lru);
+		}
+	}
+	if (f->handle != INVALID_HANDLE_VALUE) {
+		CloseHandle(f->handle);
+	}
+	delete f;
+}
+
+int VDFFFilePool::Read(void* opaque, uint8_t* buf, int buf_size)
+{
+	File* f = (File*)opaque;
+	if (!Instance().acquire(f)) {
+		return AVERROR(EIO);
+	}
+
+	// positioned read, a reopened handle needs no seek
+	OVERLAPPED ov = {};
+	ov.Offset = (DWORD)f->pos;
+	ov.OffsetHigh = (DWORD)(f->pos >> 32);
+	DWORD n = 0;
+	const BOOL ok = ReadFile(f->handle, buf, buf_size, &n, &ov);
+	f->pos += n;
+	f->mutex.unlock();
+
+	if (!ok && GetLastError() != ERROR_HANDLE_EOF) {
+		return AVERROR(EIO);
+	}
+	return n ? (int)n : AVERROR_EOF;
+}
+
+int64_t VDFFFilePool::Seek(void* opaque, int64_t offset, int whence)
+{
+	File* f = (File*)opaque;
+	std::lock_guard lock(f->mutex);
+
+	switch (whence & ~AVSEEK_FORCE) {
+	case AVSEEK_SIZE:
+		return f->size;
+	case SEEK_SET:
+		f->pos = offset;
+		return f->pos;
+	case SEEK_CUR:
+		f->pos += offset;
+		return f->pos;
+	case SEEK_END:
+		f->pos = f->size + offset;
+		return f->pos;
+	}
+	return -1;
+}
@@ -0,0 +1,51 @@
+/*
+ * Copyright (C) 2026 v0lt
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+
+#include <list>
+#include <mutex>
+
+extern "C"
+{
+#include <libavformat/avformat.h>
+}
+
+// Limits the number of open file handles of appended segments.
+// Pooled inputs are read through AVIO callbacks. When too many handles are open,
+// the least recently read file is closed and opened again at its next read,
+// the demuxer with its index stays as it is. Idle segments close their demuxers
+// too, see VDFFInputFile::close_demuxer.
+class VDFFFilePool
+{
+public:
+	static VDFFFilePool& Instance();
+
+	// like avformat_open_input, the file is read through the pool
+	int open_input(AVFormatContext** ps, const std::wstring& path, const AVInputFormat* iformat = nullptr);
+	// closes any input, frees the custom context of the pool or of VDFFIOBackend
+	static void close_input(AVFormatContext** ps);
+
+private:
+	struct File {
+		std::wstring path;
+		HANDLE   handle = INVALID_HANDLE_VALUE;
+		int64_t  pos    = 0;
+		int64_t  size   = 0;
+		bool     listed = false;
+		std::list<File*>::iterator lru;
+		std::mutex mutex; // held while the handle is used
+	};
+
+	std::mutex m_mutex;
+	std::list<File*> m_open; // files with an open handle, most recently used first
+
+	bool acquire(File* f);
+	void remove(File* f);
+
+	static int Read(void* opaque, uint8_t* buf, int buf_size);
+	static int64_t Seek(void* opaque, int64_t offset, int whence);
+};
@@ -0,0 +1,496 @@
+/*
+ * Copyright (C) 2026 v0lt
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "stdafx.h"
+
+#include <map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "IOBackend.h"
+#include "BlockCache.h"
+#include "iobuffer.h"
+#include "Utils/StringUtil.h"
+#include "Helper.h"
+
+extern int config_io_mode;
+#ifdef AVLIB_BENCH
+extern int config_io_latency; // set by the benchmark
+#endif
+
+// larger files use mmap in the ram mode
+const int64_t ram_limit = 256 * 1024 * 1024;
+
+//
+// direct
+//
+
+class IODirect : public VDFFIOBackend
+{
+public:
+	IODirect(HANDLE handle, int64_t size) : VDFFIOBackend(handle, size) {}
+
+protected:
+	int read(uint8_t* buf, int size) override
+	{
+		DWORD n = 0;
+		if (!read_file(m_pos, buf, size, n)) {
+			return AVERROR(EIO);
+		}
+		m_pos += n;
+		return n ? (int)n : AVERROR_EOF;
+	}
+};
+
+//
+// read-ahead
+//
+
+class IOReadAhead : public VDFFIOBackend
+{
+	static constexpr int block_size = 4 * 1024 * 1024;
+	static constexpr int depth      = 8; // blocks ahead of the read position
+
+	std::thread m_thread;
+	std::mutex m_mutex;
+	std::condition_variable m_cvWork;
+	std::condition_variable m_cvReady;
+	std::map<int64_t, std::unique_ptr<IOBuffer>> m_blocks; // by block index, nullptr means read error
+	int64_t m_want = 0; // block of the read position
+	bool m_stop = false;
+
+	bool in_window(int64_t block) const
+	{
+		// one block behind is kept for short backward seeks of the demuxer
+		return block >= m_want - 1 && block < m_want + depth;
+	}
+
+	int64_t next_missing() const
+	{
+		for (int64_t i = m_want; i < m_want + depth && i * block_size < m_size; i++) {
+			if (!m_blocks.contains(i)) {
+				return i;
+			}
+		}
+		return -1;
+	}
+
+	void read_thread()
+	{
+		std::unique_lock lock(m_mutex);
+		while (1) {
+			m_cvWork.wait(lock, [this] { return m_stop || next_missing() != -1; });
+			if (m_stop) {
+				break;
+			}
+			const int64_t block = next_missing();
+			const int64_t file_size = m_size;
+			lock.unlock();
+
+			const int64_t pos = block * block_size;
+			auto data = std::make_unique<IOBuffer>((int)std::min<int64_t>(block_size, file_size - pos));
+			DWORD n = 0;
+			if (!data->data || !read_file(pos, data->data, (DWORD)data->size, n)) {
+				data.reset();
+			} else {
+				data->size = n;
+			}
+
+			lock.lock();
+			// a seek may have moved the window meanwhile, or the file has grown
+			if (in_window(block) && file_size == m_size) {
+				m_blocks[block] = std::move(data);
+				m_cvReady.notify_all();
+			}
+		}
+	}
+
+public:
+	IOReadAhead(HANDLE handle, int64_t size) : VDFFIOBackend(handle, size)
+	{
+		m_thread = std::thread(&IOReadAhead::read_thread, this);
+	}
+
+	~IOReadAhead()
+	{
+		{
+			std::lock_guard lock(m_mutex);
+			m_stop = true;
+		}
+		m_cvWork.notify_all();
+		m_thread.join();
+	}
+
+protected:
+	int read(uint8_t* buf, int size) override
+	{
+		if (m_pos >= m_size) {
+			return AVERROR_EOF;
+		}
+		const int64_t block = m_pos / block_size;
+
+		std::unique_lock lock(m_mutex);
+		if (block != m_want) {
+			// blocks around the new position stay, the others are dropped
+			m_want = block;
+			std::erase_if(m_blocks, [this](const auto& item) { return !in_window(item.first); });
+			m_cvWork.notify_one();
+		}
+		m_cvReady.wait(lock, [&] { return m_blocks.contains(block); });
+
+		auto it = m_blocks.find(block);
+		IOBuffer* data = it->second.get();
+		if (!data) {
+			// read again on the next attempt
+			m_blocks.erase(it);
+			m_cvWork.notify_one();
+			return AVERROR(EIO);
+		}
+		const int64_t offset = m_pos - block * block_size;
+		const int n = (int)std::min<int64_t>(size, data->size - offset);
+		if (n <= 0) {
+			return AVERROR_EOF;
+		}
+		memcpy(buf, data->data + offset, n);
+		m_pos += n;
+
+		return n;
+	}
+
+	bool has_data() const override { return true; }
+
+	void resize(int64_t size) override
+	{
+		std::lock_guard lock(m_mutex);
+		// the old last block is short
+		std::erase_if(m_blocks, [this](const auto& item) { return (item.first + 1) * block_size > m_size; });
+		m_size = size;
+		m_cvWork.notify_one();
+	}
+};
+
+//
+// mmap
+//
+
+// page faults of mapped network files raise exceptions instead of returning errors
+static bool copy_mapped(void* dst, const void* src, size_t size)
+{
+	__try {
+		memcpy(dst, src, size);
+	}
+	__except (GetExceptionCode() == EXCEPTION_IN_PAGE_ERROR ? EXCEPTION_EXECUTE_HANDLER : EXCEPTION_CONTINUE_SEARCH) {
+		return false;
+	}
+	return true;
+}
+
+class IOMmap : public VDFFIOBackend
+{
+	// a window of the file is mapped, 32-bit builds can not map large files at once
+	static constexpr int64_t view_size = 64 * 1024 * 1024;
+
+	HANDLE   m_mapping  = nullptr;
+	uint8_t* m_view     = nullptr;
+	int64_t  m_viewPos  = 0;
+	int64_t  m_viewSize = 0;
+
+public:
+	IOMmap(HANDLE handle, int64_t size) : VDFFIOBackend(handle, size)
+	{
+		m_mapping = CreateFileMappingW(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	}
+
+	~IOMmap()
+	{
+		if (m_view) {
+			UnmapViewOfFile(m_view);
+		}
+		if (m_mapping) {
+			CloseHandle(m_mapping);
+		}
+	}
+
+	bool is_mapped() const { return m_mapping != nullptr; }
+
+protected:
+	int read(uint8_t* buf, int size) override
+	{
+		if (m_pos >= m_size) {
+			return AVERROR_EOF;
+		}
+		if (!m_view || m_pos < m_viewPos || m_pos >= m_viewPos + m_viewSize) {
+			if (m_view) {
+				UnmapViewOfFile(m_view);
+			}
+			// the offset must be a multiple of the allocation granularity (64 KB)
+			m_viewPos  = m_pos & ~int64_t(0xFFFF);
+			m_viewSize = std::min(view_size, m_size - m_viewPos);
+			m_view = (uint8_t*)MapViewOfFile(m_mapping, FILE_MAP_READ, DWORD(m_viewPos >> 32), DWORD(m_viewPos), (SIZE_T)m_viewSize);
+			if (!m_view) {
+				return AVERROR(EIO);
+			}
+#ifdef AVLIB_BENCH
+			if (config_io_latency > 0) {
+				Sleep(config_io_latency);
+			}
+#endif
+		}
+
+		const int n = (int)std::min<int64_t>(size, m_viewPos + m_viewSize - m_pos);
+		if (!copy_mapped(buf, m_view + (m_pos - m_viewPos), n)) {
+			return AVERROR(EIO);
+		}
+		m_pos += n;
+
+		return n;
+	}
+
+	void resize(int64_t size) override
+	{
+		// the mapping covers the file size at its creation
+		HANDLE mapping = CreateFileMappingW(m_handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (!mapping) {
+			return;
+		}
+		if (m_view) {
+			UnmapViewOfFile(m_view);
+			m_view = nullptr;
+		}
+		CloseHandle(m_mapping);
+		m_mapping = mapping;
+		m_size = size;
+	}
+};
+
+//
+// ram
+//
+
+class IORam : public VDFFIOBackend
+{
+	std::unique_ptr<IOBuffer> m_data;
+
+public:
+	IORam(HANDLE handle, int64_t size) : VDFFIOBackend(handle, size)
+	{
+		m_data = std::make_unique<IOBuffer>((int)size);
+		DWORD n = 0;
+		if (!m_data->data || !read_file(0, m_data->data, (DWORD)size, n) || n != (DWORD)size) {
+			m_data.reset();
+		}
+	}
+
+	bool is_loaded() const { return m_data != nullptr; }
+	bool has_data() const override { return true; }
+
+protected:
+	int read(uint8_t* buf, int size) override
+	{
+		m_data->pos = m_pos;
+		const int n = IOBuffer::Read(m_data.get(), buf, size);
+		m_pos = m_data->pos;
+		return n;
+	}
+
+	// the loaded copy keeps its size
+	void resize(int64_t size) override {}
+};
+
+//
+// cache
+//
+
+class IOShared : public VDFFIOBackend
+{
+	std::wstring m_path;
+	std::wstring m_key;
+
+public:
+	IOShared(HANDLE handle, int64_t size, const std::wstring& path) : VDFFIOBackend(handle, size), m_path(path)
+	{
+		m_key = VDFFBlockCache::make_key(path, handle);
+	}
+
+protected:
+	int read(uint8_t* buf, int size) override
+	{
+		if (m_pos >= m_size) {
+			return AVERROR_EOF;
+		}
+		const int n = VDFFBlockCache::Instance().read(m_key, m_pos, buf, size,
+			[this](int64_t pos, uint8_t* data, DWORD data_size, DWORD& done) {
+				return read_file(pos, data, data_size, done);
+			});
+		if (n < 0) {
+			return AVERROR(EIO);
+		}
+		m_pos += n;
+		return n ? n : AVERROR_EOF;
+	}
+
+	void resize(int64_t size) override
+	{
+		// the cached last block is short, the blocks of the old version are evicted in time
+		m_key = VDFFBlockCache::make_key(m_path, m_handle);
+		m_size = size;
+	}
+};
+
+//
+// VDFFIOBackend
+//
+
+VDFFIOBackend::~VDFFIOBackend()
+{
+	if (m_handle != INVALID_HANDLE_VALUE) {
+		CloseHandle(m_handle);
+	}
+}
+
+bool VDFFIOBackend::read_file(int64_t pos, uint8_t* buf, DWORD size, DWORD& done)
+{
+#ifdef AVLIB_BENCH
+	// stands in for a file server in benchmarks
+	if (config_io_latency > 0) {
+		Sleep(config_io_latency);
+	}
+#endif
+
+	OVERLAPPED ov = {};
+	ov.Offset = (DWORD)pos;
+	ov.OffsetHigh = (DWORD)(pos >> 32);
+	done = 0;
+	if (!ReadFile(m_handle, buf, size, &done, &ov) && GetLastError() != ERROR_HANDLE_EOF) {
+		return false;
+	}
+	return true;
+}
+
+VDFFIOBackend* VDFFIOBackend::create(int mode, HANDLE handle, int64_t size, const std::wstring& path)
+{
+	if (mode == io_cache) {
+		return new IOShared(handle, size, path);
+	}
+	if (mode == io_ram && size > 0 && size <= ram_limit) {
+		auto ram = std::make_unique<IORam>(handle, size);
+		if (ram->is_loaded()) {
+			return ram.release();
+		}
+		// the handle is needed by the next backend
+		ram->m_handle = INVALID_HANDLE_VALUE;
+	}
+	if ((mode == io_ram || mode == io_mmap) && size > 0) {
+		auto mmap = std::make_unique<IOMmap>(handle, size);
+		if (mmap->is_mapped()) {
+			return mmap.release();
+		}
+		mmap->m_handle = INVALID_HANDLE_VALUE;
+	}
+	if (mode == io_read_ahead) {
+		return new IOReadAhead(handle, size);
+	}
+	return new IODirect(handle, size);
+}
+
+int VDFFIOBackend::open_input(AVFormatContext** ps, const std::wstring& path, const AVInputFormat* iformat)
+{
+	std::string ff_path = ConvertWideToUtf8(path);
+
+	HANDLE handle = INVALID_HANDLE_VALUE;
+	if (config_io_mode != io_ffmpeg) {
+		const DWORD flags = config_io_mode == io_read_ahead ? FILE_FLAG_SEQUENTIAL_SCAN : FILE_ATTRIBUTE_NORMAL;
+		handle = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, flags, nullptr);
+	}
+	LARGE_INTEGER size;
+	if (handle != INVALID_HANDLE_VALUE && !GetFileSizeEx(handle, &size)) {
+		CloseHandle(handle);
+		handle = INVALID_HANDLE_VALUE;
+	}
+	if (handle == INVALID_HANDLE_VALUE) {
+		// also for URLs and other protocols
+		return avformat_open_input(ps, ff_path.c_str(), iformat, nullptr);
+	}
+
+	VDFFIOBackend* backend = create(config_io_mode, handle, size.QuadPart, path);
+
+	const int io_size = 64 * 1024;
+	uint8_t* io_buf = (uint8_t*)av_malloc(io_size);
+	AVIOContext* pb = avio_alloc_context(io_buf, io_size, 0, backend, &Read, nullptr, &Seek);
+
+	AVFormatContext* fmt = avformat_alloc_context();
+	fmt->pb = pb;
+	fmt->flags |= AVFMT_FLAG_CUSTOM_IO;
+
+	int err = avformat_open_input(&fmt, ff_path.c_str(), iformat, nullptr);
+	if (err < 0) {
+		// fmt is freed by avformat_open_input, the custom context is not
+		free_context(pb);
+		return err;
+	}
+
+	*ps = fmt;
+	return 0;
+}
+
+bool VDFFIOBackend::free_context(AVIOContext* pb)
+{
+	if (!pb || pb->read_packet != &Read) {
+		return false;
+	}
+	delete (VDFFIOBackend*)pb->opaque;
+	av_freep(&pb->buffer);
+	avio_context_free(&pb);
+	return true;
+}
+
+bool VDFFIOBackend::holds_data(const AVIOContext* pb)
+{
+	return pb && pb->read_packet == &Read && ((const VDFFIOBackend*)pb->opaque)->has_data();
+}
+
+void VDFFIOBackend::update_size(AVIOContext* pb)
+{
+	if (!pb) {
+		return;
+	}
+	pb->eof_reached = 0;
+	// the FFmpeg file protocol asks the file for its size
+	if (pb->read_packet != &Read) {
+		return;
+	}
+	VDFFIOBackend* b = (VDFFIOBackend*)pb->opaque;
+	LARGE_INTEGER size;
+	if (GetFileSizeEx(b->m_handle, &size) && size.QuadPart > b->m_size) {
+		b->resize(size.QuadPart);
+	}
+}
+
+int VDFFIOBackend::Read(void* opaque, uint8_t* buf, int buf_size)
+{
+	return ((VDFFIOBackend*)opaque)->read(buf, buf_size);
+}
+
+int64_t VDFFIOBackend::Seek(void* opaque, int64_t offset, int whence)
+{
+	VDFFIOBackend* b = (VDFFIOBackend*)opaque;
+
+	switch (whence & ~AVSEEK_FORCE) {
+	case AVSEEK_SIZE:
+		return b->m_size;
+	case SEEK_SET:
+		b->m_pos = offset;
+		return b->m_pos;
+	case SEEK_CUR:
+		b->m_pos += offset;
+		return b->m_pos;
+	case SEEK_END:
+		b->m_pos = b->m_size + offset;
+		return b->m_pos;
+	}
+	return -1;
+}
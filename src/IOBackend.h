@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2026 v0lt
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+
+#include <string>
+
+extern "C"
+{
+#include <libavformat/avformat.h>
+}
+
+// Custom AVIO backends for input files, selected by the "io_mode" option.
+//   direct     - synchronous positioned reads, the access pattern of the FFmpeg file protocol
+//   read-ahead - a thread reads large blocks ahead of the demuxer, for storage with high latency (SMB, NFS)
+//   mmap       - reads are copied from a mapped view of the file, without a system call per read
+//   ram        - the whole file is loaded into memory, meant for small files such as overlay assets
+//   cache      - blocks are shared by all contexts of the same file (video, audio tracks, export), see VDFFBlockCache
+class VDFFIOBackend
+{
+public:
+	enum Mode {
+		io_ffmpeg = 0, // FFmpeg file protocol, no backend
+		io_direct,
+		io_read_ahead,
+		io_mmap,
+		io_ram,
+		io_cache,
+	};
+
+	virtual ~VDFFIOBackend();
+
+	// like avformat_open_input, the file is read through the selected backend
+	static int open_input(AVFormatContext** ps, const std::wstring& path, const AVInputFormat* iformat = nullptr);
+	// frees the custom context after avformat_close_input, returns false if pb does not belong to a backend
+	static bool free_context(AVIOContext* pb);
+	// the file has grown, reads continue past the old end
+	static void update_size(AVIOContext* pb);
+	// true if the backend of pb runs a thread or keeps file data in memory (read-ahead, ram)
+	static bool holds_data(const AVIOContext* pb);
+
+protected:
+	HANDLE  m_handle = INVALID_HANDLE_VALUE;
+	int64_t m_size   = 0;
+	int64_t m_pos    = 0;
+
+	VDFFIOBackend(HANDLE handle, int64_t size) : m_handle(handle), m_size(size) {}
+
+	// positioned read from the file, the injected latency is added here
+	bool read_file(int64_t pos, uint8_t* buf, DWORD size, DWORD& done);
+	// reads at m_pos and advances it
+	virtual int read(uint8_t* buf, int size) = 0;
+	// sets m_size to the new size of the file
+	virtual void resize(int64_t size) { m_size = size; }
+	virtual bool has_data() const { return false; }
+
+private:
+	static VDFFIOBackend* create(int mode, HANDLE handle, int64_t size, const std::wstring& path);
+	static int Read(void* opaque, uint8_t* buf, int buf_size);
+	static int64_t Seek(void* opaque, int64_t offset, int whence);
+};
@@ -0,0 +1,344 @@
+/*
+ * Copyright (C) 2026 v0lt
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "stdafx.h"
+
+#include "ImageSequence.h"
+#include "iobuffer.h"
+#include "Utils/StringUtil.h"
+#include "Helper.h"
+
+VDFFImageSequence::VDFFImageSequence(std::wstring_view pattern, std::vector<int>&& numbers, const AVInputFormat* iformat, const AVCodecParameters* codecpar, int thread_count, int io_thread_count, int io_depth)
+	: m_pattern(pattern)
+	, m_numbers(std::move(numbers))
+	, m_iformat(iformat)
+	, m_ioDepth(io_depth)
+	, m_pool(thread_count)
+{
+	if (io_thread_count > 0 && io_depth > 0) {
+		m_ioPool = std::make_unique<ThreadPool>(io_thread_count);
+	}
+
+	m_codecpar = avcodec_parameters_alloc();
+	avcodec_parameters_copy(m_codecpar, codecpar);
+
+	for (size_t i = 1; i < m_numbers.size(); i++) {
+		if (m_numbers[i] == m_numbers[i - 1]) {
+			m_missing++;
+		}
+	}
+
+	DLog(L"VDFFImageSequence: {} frames ({} missing), {} decoding threads, {} I/O threads",
+		m_numbers.size(), m_missing, m_pool.GetThreadCount(), m_ioPool ? m_ioPool->GetThreadCount() : 0);
+}
+
+VDFFImageSequence::~VDFFImageSequence()
+{
+	// finished reads push decoding tasks, so stop the I/O first
+	if (m_ioPool) {
+		m_ioPool->Clear();
+		m_ioPool->Wait();
+	}
+	m_pool.Clear();
+	m_pool.Wait();
+
+	for (auto& [frame, pic] : m_ready) {
+		av_frame_free(&pic);
+	}
+	for (auto& avctx : m_decoders) {
+		avcodec_free_context(&avctx);
+	}
+	avcodec_parameters_free(&m_codecpar);
+}
+
+std::wstring VDFFImageSequence::frame_path(const int frame) const
+{
+	wchar_t path[MAX_PATH];
+	swprintf_s(path, m_pattern.c_str(), m_numbers[frame]);
+	return path;
+}
+
+void VDFFImageSequence::request(const int frame)
+{
+	if (frame < 0 || frame >= (int)m_numbers.size()) {
+		return;
+	}
+
+	{
+		std::lock_guard lock(m_mutex);
+		if (m_queued.contains(frame) || m_ready.contains(frame)) {
+			return;
+		}
+		m_queued.insert(frame);
+
+		if (m_ioPool && !m_loaded.contains(frame)) {
+			// decoding is started when the file is read
+			if (m_reading.insert(frame).second) {
+				m_ioPool->Push([this, frame] { read_task(frame); });
+			}
+			return;
+		}
+	}
+
+	m_pool.Push([this, frame] { decode_task(frame); });
+}
+
+void VDFFImageSequence::read_file(const int frame)
+{
+	if (!m_ioPool || frame < 0 || frame >= (int)m_numbers.size()) {
+		return;
+	}
+
+	std::lock_guard lock(m_mutex);
+	if (m_queued.contains(frame) || m_ready.contains(frame) || m_loaded.contains(frame)) {
+		return;
+	}
+	if (m_reading.insert(frame).second) {
+		m_ioPool->Push([this, frame] { read_task(frame); });
+	}
+}
+
+void VDFFImageSequence::retain_files(const int first, const int last)
+{
+	std::lock_guard lock(m_mutex);
+
+	std::erase_if(m_reading, [&](const int frame) {
+		return (frame < first || frame > last) && !m_queued.contains(frame);
+	});
+	std::erase_if(m_loaded, [&](const auto& item) {
+		return (item.first < first || item.first > last) && !m_queued.contains(item.first);
+	});
+}
+
+void VDFFImageSequence::retain(const int first, const int last)
+{
+	std::lock_guard lock(m_mutex);
+
+	// queued tasks check m_queued before decoding, running tasks drop the result
+	std::erase_if(m_queued, [&](const int frame) { return frame < first || frame > last; });
+
+	for (auto it = m_ready.begin(); it != m_ready.end();) {
+		if (it->first < first || it->first > last) {
+			av_frame_free(&it->second);
+			it = m_ready.erase(it);
+		} else {
+			++it;
+		}
+	}
+}
+
+AVFrame* VDFFImageSequence::take(const int frame, const bool wait)
+{
+	std::unique_lock lock(m_mutex);
+
+	if (wait) {
+		m_cvReady.wait(lock, [&] { return m_ready.contains(frame) || !m_queued.contains(frame); });
+	}
+
+	auto it = m_ready.find(frame);
+	if (it == m_ready.end()) {
+		return nullptr;
+	}
+	AVFrame* pic = it->second;
+	m_ready.erase(it);
+
+	return pic;
+}
+
+void VDFFImageSequence::decode_task(const int frame)
+{
+	std::unique_ptr<IOBuffer> file;
+	{
+		std::lock_guard lock(m_mutex);
+		if (!m_queued.contains(frame)) {
+			// no longer needed
+			return;
+		}
+		auto it = m_loaded.find(frame);
+		if (it != m_loaded.end()) {
+			file = std::move(it->second);
+			m_loaded.erase(it);
+		}
+	}
+
+	AVFrame* pic = nullptr;
+	AVCodecContext* avctx = get_decoder();
+	if (avctx) {
+		pic = decode_file(avctx, frame, file.get());
+		put_decoder(avctx);
+	}
+
+	{
+		std::lock_guard lock(m_mutex);
+		if (m_queued.erase(frame)) {
+			m_ready[frame] = pic;
+			pic = nullptr;
+		}
+	}
+	av_frame_free(&pic);
+
+	m_cvReady.notify_all();
+}
+
+void VDFFImageSequence::read_task(const int frame)
+{
+	{
+		std::lock_guard lock(m_mutex);
+		if (!m_reading.contains(frame)) {
+			// no longer needed
+			return;
+		}
+	}
+
+	std::unique_ptr<IOBuffer> file = load_file(frame);
+
+	bool decode = false;
+	{
+		std::lock_guard lock(m_mutex);
+		if (m_reading.erase(frame)) {
+			m_loaded[frame] = std::move(file);
+			decode = m_queued.contains(frame);
+		}
+	}
+
+	if (decode) {
+		m_pool.Push([this, frame] { decode_task(frame); });
+	}
+}
+
+std::unique_ptr<IOBuffer> VDFFImageSequence::load_file(const int frame)
+{
+	HANDLE hFile = CreateFileW(frame_path(frame).c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (hFile == INVALID_HANDLE_VALUE) {
+		return nullptr;
+	}
+
+	std::unique_ptr<IOBuffer> file;
+	LARGE_INTEGER size;
+	if (GetFileSizeEx(hFile, &size) && size.QuadPart > 0 && size.QuadPart < INT_MAX - AVPROBE_PADDING_SIZE) {
+		file = std::make_unique<IOBuffer>((int)size.QuadPart);
+		DWORD n = 0;
+		if (!file->data || !ReadFile(hFile, file->data, (DWORD)size.QuadPart, &n, nullptr) || n != (DWORD)size.QuadPart) {
+			file.reset();
+		}
+	}
+	CloseHandle(hFile);
+
+	return file;
+}
+
+AVFrame* VDFFImageSequence::decode_file(AVCodecContext* avctx, const int frame, IOBuffer* file)
+{
+	std::string ff_path = ConvertWideToUtf8(frame_path(frame));
+
+	AVFormatContext* fmt = nullptr;
+	AVIOContext* avio_ctx = nullptr;
+	const AVInputFormat* iformat = m_iformat;
+
+	if (file && (iformat->flags & AVFMT_NOFILE)) {
+		// image2 opens files itself, image2pipe reads from the buffer
+		iformat = av_find_input_format("image2pipe");
+		if (!iformat) {
+			iformat = m_iformat;
+			file = nullptr;
+		}
+	}
+	if (file) {
+		const int io_size = 64 * 1024;
+		uint8_t* io_buf = (uint8_t*)av_malloc(io_size);
+		avio_ctx = avio_alloc_context(io_buf, io_size, 0, file, &IOBuffer::Read, nullptr, &IOBuffer::Seek);
+		fmt = avformat_alloc_context();
+		fmt->pb = avio_ctx;
+		fmt->flags |= AVFMT_FLAG_CUSTOM_IO;
+		fmt->video_codec_id = m_codecpar->codec_id;
+	}
+
+	int ret = avformat_open_input(&fmt, ff_path.c_str(), iformat, nullptr);
+	if (ret != 0) {
+		DLog("VDFFImageSequence: unable to open {}", ff_path);
+		if (avio_ctx) {
+			av_freep(&avio_ctx->buffer);
+			avio_context_free(&avio_ctx);
+		}
+		return nullptr;
+	}
+
+	AVPacket* pkt = av_packet_alloc();
+	AVFrame* pic = av_frame_alloc();
+
+	while ((ret = av_read_frame(fmt, pkt)) == 0) {
+		if (pkt->stream_index == 0) {
+			break;
+		}
+		av_packet_unref(pkt);
+	}
+
+	if (ret == 0) {
+		ret = avcodec_send_packet(avctx, pkt);
+		av_packet_unref(pkt);
+	}
+	if (ret == 0) {
+		ret = avcodec_receive_frame(avctx, pic);
+		if (ret == AVERROR(EAGAIN)) {
+			// some decoders hold the picture until drained
+			avcodec_send_packet(avctx, nullptr);
+			ret = avcodec_receive_frame(avctx, pic);
+		}
+	}
+	// make the decoder ready for the next file
+	avcodec_flush_buffers(avctx);
+
+	av_packet_free(&pkt);
+	avformat_close_input(&fmt);
+	if (avio_ctx) {
+		av_freep(&avio_ctx->buffer);
+		avio_context_free(&avio_ctx);
+	}
+
+	if (ret != 0) {
+		DLog("VDFFImageSequence: unable to decode {}", ff_path);
+		av_frame_free(&pic);
+	}
+
+	return pic;
+}
+
+AVCodecContext* VDFFImageSequence::get_decoder()
+{
+	{
+		std::lock_guard lock(m_decodersMutex);
+		if (m_decoders.size()) {
+			AVCodecContext* avctx = m_decoders.back();
+			m_decoders.pop_back();
+			return avctx;
+		}
+	}
+
+	const AVCodec* pDecoder = avcodec_find_decoder(m_codecpar->codec_id);
+	if (!pDecoder) {
+		return nullptr;
+	}
+	AVCodecContext* avctx = avcodec_alloc_context3(pDecoder);
+	if (!avctx) {
+		return nullptr;
+	}
+	avcodec_parameters_to_context(avctx, m_codecpar);
+	// frames are decoded in parallel, one thread per decoder is enough
+	avctx->thread_count = 1;
+
+	if (avcodec_open2(avctx, pDecoder, nullptr) < 0) {
+		avcodec_free_context(&avctx);
+		return nullptr;
+	}
+
+	return avctx;
+}
+
+void VDFFImageSequence::put_decoder(AVCodecContext* avctx)
+{
+	std::lock_guard lock(m_decodersMutex);
+	m_decoders.emplace_back(avctx);
+}
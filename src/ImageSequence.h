@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2026 v0lt
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+
+#include <map>
+#include <set>
+#include "Utils/ThreadPool.h"
+
+struct IOBuffer;
+
+extern "C"
+{
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+}
+
+// Decodes image sequences (one file per frame) on a thread pool.
+// Every frame is an independent file, so each worker opens its own demuxer
+// and takes its own decoder instance, the caller moves ready frames to the cache.
+// Optionally, separate I/O threads read the files ahead into memory
+// and the demuxer is fed from the memory buffer.
+class VDFFImageSequence
+{
+public:
+	// numbers maps frames to file numbers, missing files repeat the previous number
+	VDFFImageSequence(std::wstring_view pattern, std::vector<int>&& numbers, const AVInputFormat* iformat, const AVCodecParameters* codecpar, int thread_count, int io_thread_count, int io_depth);
+	~VDFFImageSequence();
+
+	int get_frame_count() const { return (int)m_numbers.size(); }
+	int get_missing_count() const { return m_missing; }
+	int get_thread_count() const { return m_pool.GetThreadCount(); }
+	// how many frames ahead of the playback position should be requested
+	int get_prefetch_count() const { return m_pool.GetThreadCount() * 2; }
+	// how many files ahead of the playback position should be read, 0 if there are no I/O threads
+	int get_read_ahead_count() const { return m_ioPool ? std::max(m_ioDepth, get_prefetch_count()) : 0; }
+
+	std::wstring frame_path(const int frame) const;
+	// the frame whose file is shown at this position (differs for missing files)
+	int source_frame(const int frame) const { return m_numbers[frame] - m_numbers[0]; }
+
+	// queue the frame for decoding, nothing happens if it is already queued or ready
+	void request(const int frame);
+	// forget queued and ready frames outside [first, last]
+	void retain(const int first, const int last);
+	// get the decoded frame, the caller owns the result
+	// returns nullptr if the frame is not ready (wait = false) or decoding failed
+	AVFrame* take(const int frame, const bool wait);
+
+	// queue the file for reading into memory
+	void read_file(const int frame);
+	// forget file buffers outside [first, last] unless they are waiting for decoding
+	void retain_files(const int first, const int last);
+
+private:
+	std::wstring m_pattern;
+	std::vector<int> m_numbers;
+	int m_missing = 0;
+
+	const AVInputFormat* m_iformat  = nullptr;
+	AVCodecParameters*   m_codecpar = nullptr;
+
+	std::mutex m_mutex;
+	std::condition_variable m_cvReady;
+	std::set<int> m_queued;
+	std::map<int, AVFrame*> m_ready; // nullptr means decoding error
+
+	int m_ioDepth = 0;
+	std::set<int> m_reading; // queued or running file reads
+	std::map<int, std::unique_ptr<IOBuffer>> m_loaded; // nullptr means read error
+
+	std::mutex m_decodersMutex;
+	std::vector<AVCodecContext*> m_decoders; // idle decoder instances
+
+	ThreadPool m_pool;
+	std::unique_ptr<ThreadPool> m_ioPool;
+
+	void decode_task(const int frame);
+	void read_task(const int frame);
+	std::unique_ptr<IOBuffer> load_file(const int frame);
+	AVFrame* decode_file(AVCodecContext* avctx, const int frame, IOBuffer* file);
+	AVCodecContext* get_decoder();
+	void put_decoder(AVCodecContext* avctx);
+};
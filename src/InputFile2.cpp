@@ -11,6 +11,11 @@
 #include "FileInfo2.h"
 #include "VideoSource2.h"
 #include "AudioSource2.h"
+#include "ImageSequence.h"
+#include "DemuxHub.h"
+#include "FilePool.h"
+#include "ProbeCache.h"
+#include "IOBackend.h"
 #include "mov_mp4.h"
 #include "export.h"
 #include <vfw.h>
@@ -19,7 +24,11 @@
 #include "Helper.h"
 #include "ffmpeg_helper.h"
 #include "iobuffer.h"
+#include "Utils/ContainerSignature.h"
+#include "Utils/ImageList.h"
+#include "Utils/SegmentTable.h"
 #include "Utils/StringUtil.h"
+#include "Utils/ThreadPool.h"
 extern "C" {
 #include <libavutil/error.h>
 }
@@ -32,6 +41,14 @@ typedef struct AVCodecTag {
 extern bool config_decode_raw;
 extern bool config_decode_magic;
 extern bool config_disable_cache;
+extern int config_image_threads;
+extern int config_image_io_threads;
+extern int config_image_io_depth;
+extern bool config_shared_demux;
+extern int config_growing_check;
+
+// larger gaps in the numbering end the image sequence
+const int max_image_list_gap = 1000;
 
 bool FileExist(const wchar_t* name)
 {
@@ -318,6 +335,19 @@ void copyCharToWchar(wchar_t* dst, size_t dst_size, const char* src)
 	dst[dst_size - 1] = 0;
 }
 
+// containers that are recognized by their signature, without opening the file
+IVDXInputFileDriver::DetectionConfidence detect_container(VDXMediaInfo& info, const void* pHeader, int32_t nHeaderSize)
+{
+	const char* name = FindContainerSignature(pHeader, nHeaderSize);
+	if (!name) {
+		return IVDXInputFileDriver::kDC_None;
+	}
+	copyCharToWchar(info.format_name, std::size(info.format_name), name);
+
+	// same as detect_ff reports after probing
+	return IVDXInputFileDriver::kDC_Moderate;
+}
+
 IVDXInputFileDriver::DetectionConfidence detect_ff(VDXMediaInfo& info, const void* pHeader, int32_t nHeaderSize, const wchar_t* fileName)
 {
 	init_av();
@@ -352,23 +382,24 @@ IVDXInputFileDriver::DetectionConfidence detect_ff(VDXMediaInfo& info, const voi
 		return IVDXInputFileDriver::kDC_None;
 	}
 
-	std::string ff_path = ConvertWideToUtf8(fileName);
-
 	AVFormatContext* ctx = nullptr;
 	int err = 0;
-	err = avformat_open_input(&ctx, ff_path.c_str(), nullptr, nullptr);
+	err = VDFFIOBackend::open_input(&ctx, fileName);
 	if (err != 0) {
 		return IVDXInputFileDriver::kDC_None;
 	}
 
+	// same as in OpenVideoFile, the context is reused there
+	ctx->max_index_size = 512 * 1024 * 1024;
+
 	err = avformat_find_stream_info(ctx, nullptr);
 	if (err < 0) {
-		avformat_close_input(&ctx);
+		VDFFFilePool::close_input(&ctx);
 		return IVDXInputFileDriver::kDC_None;
 	}
 	fmt = ctx->iformat;
 	copyCharToWchar(info.format_name, std::size(info.format_name), fmt->name);
-	avformat_close_input(&ctx);
+	VDFFProbeCache::Instance().put(fileName, ctx);
 
 	return IVDXInputFileDriver::kDC_Moderate;
 }
@@ -435,6 +466,12 @@ int VDXAPIENTRY VDFFInputFileDriver::DetectBySignature3(VDXMediaInfo& info, cons
 		return detConf;
 	}
 
+	// full probing is left for data that is not recognized by its signature
+	detConf = detect_container(info, pHeader, nHeaderSize);
+	if (detConf >= kDC_Moderate) {
+		return detConf;
+	}
+
 	detConf = detect_ff(info, pHeader, nHeaderSize, fileName);
 
 	return detConf;
@@ -527,6 +564,71 @@ bool VDXAPIENTRY VDFFInputFile::CreateOptions(const void* buf, uint32_t len, IVD
 
 //----------------------------------------------------------------------------------------------
 
+// Segments are opened on worker threads, their errors are held back
+// and passed to the host when the segment is linked.
+// Errors of the pre-warming thread are never passed, the next Read of the host repeats the work.
+class VDFFSegmentCallbacks : public IVDXPluginCallbacks
+{
+public:
+	VDXInputDriverContext context;
+	static thread_local bool t_prewarm; // set on the pre-warming thread
+
+	VDFFSegmentCallbacks(const VDXInputDriverContext& host)
+		: m_host(host.mpCallbacks)
+	{
+		context.mAPIVersion = host.mAPIVersion;
+		context.mpCallbacks = this;
+	}
+
+	void* VDXAPIENTRY GetExtendedAPI(const char* pExtendedAPIName) override { return m_host->GetExtendedAPI(pExtendedAPIName); }
+	uint32 VDXAPIENTRY GetCPUFeatureFlags() override { return m_host->GetCPUFeatureFlags(); }
+
+	void VDXAPIENTRYV SetError(const char* format, ...) override
+	{
+		char buf[1024];
+		va_list args;
+		va_start(args, format);
+		vsnprintf(buf, sizeof(buf), format, args);
+		va_end(args);
+
+		if (t_prewarm) {
+			DLog(L"VDFFSegmentCallbacks: pre-warming error: {}", ConvertUtf8ToWide(buf));
+		} else if (m_held) {
+			m_error = buf;
+		} else {
+			m_host->SetError("%s", buf);
+		}
+	}
+
+	void VDXAPIENTRY SetErrorOutOfMemory() override
+	{
+		if (t_prewarm) {
+			DLog(L"VDFFSegmentCallbacks: pre-warming error: out of memory");
+		} else if (m_held) {
+			m_error = "Out of memory.";
+		} else {
+			m_host->SetErrorOutOfMemory();
+		}
+	}
+
+	// report the held error with the file that caused it, further errors go directly to the host
+	void release(const std::wstring& path)
+	{
+		m_held = false;
+		if (m_error.size()) {
+			m_host->SetError("%s\n%s", ConvertWideToUtf8(path).c_str(), m_error.c_str());
+			m_error.clear();
+		}
+	}
+
+private:
+	IVDXPluginCallbacks* m_host;
+	std::string m_error;
+	bool m_held = true;
+};
+
+thread_local bool VDFFSegmentCallbacks::t_prewarm = false;
+
 VDFFInputFile::VDFFInputFile(const VDXInputDriverContext& context)
 	: mContext(context)
 {
@@ -534,6 +636,9 @@ VDFFInputFile::VDFFInputFile(const VDXInputDriverContext& context)
 
 VDFFInputFile::~VDFFInputFile()
 {
+	// pending tasks use the segments
+	segment_prewarm.reset();
+	growth_check.reset();
 	if (next_segment) {
 		next_segment->Release();
 	}
@@ -543,9 +648,11 @@ VDFFInputFile::~VDFFInputFile()
 	if (audio_source) {
 		audio_source->Release();
 	}
+	delete image_sequence;
 	if (m_pFormatCtx) {
-		avformat_close_input(&m_pFormatCtx);
+		VDFFFilePool::close_input(&m_pFormatCtx);
 	}
+	avformat_free_context(stream_info);
 }
 
 void VDFFInputFile::DisplayInfo(VDXHWND hwndParent)
@@ -554,6 +661,15 @@ void VDFFInputFile::DisplayInfo(VDXHWND hwndParent)
 	dlg.Show(hwndParent, this);
 }
 
+static int64_t get_file_size(const std::wstring& path)
+{
+	WIN32_FILE_ATTRIBUTE_DATA fad;
+	if (!GetFileAttributesExW(path.c_str(), GetFileExInfoStandard, &fad)) {
+		return -1;
+	}
+	return ((int64_t)fad.nFileSizeHigh << 32) | fad.nFileSizeLow;
+}
+
 void VDFFInputFile::Init(const wchar_t* szFile, IVDXInputOptions* in_opts)
 {
 	DLog(L"VDFFInputFile::Init - {}", szFile);
@@ -580,6 +696,13 @@ void VDFFInputFile::Init(const wchar_t* szFile, IVDXInputOptions* in_opts)
 	//! this context instance is granted to video stream: wasted in audio-only mode
 	// audio will manage its own
 	m_pFormatCtx = OpenVideoFile();
+	if (m_pFormatCtx) {
+		stream_info = VDFFProbeCache::copy_stream_info(m_pFormatCtx);
+	}
+	if (m_pFormatCtx && config_growing_check > 0 && !is_image && !is_image_list) {
+		m_fileSize = get_file_size(m_path);
+		growth_check = std::make_unique<ThreadPool>(1);
+	}
 
 	if (auto_append) {
 		do_auto_append(szFile);
@@ -603,17 +726,44 @@ void VDFFInputFile::do_auto_append(const wchar_t* szFile)
 		return;
 	}
 	if (ext[-3] == '.' && ext[-2] == '0' && ext[-1] == '0') {
-		int x = 1;
+		std::vector<std::wstring> paths;
 		const std::wstring base(szFile, ext - szFile - 3);
-		while (1) {
+		for (int x = 1; ; x++) {
 			std::wstring filepath = base + std::format(L".{:02}", x) + ext;
 			if (!FileExist(filepath.c_str())) {
 				break;
 			}
-			if (!Append(filepath.c_str())) {
+			paths.emplace_back(std::move(filepath));
+		}
+		if (paths.empty()) {
+			return;
+		}
+
+		// the segments are independent files, probe them and load their indexes at once,
+		// link them in order, the decoders are opened on first access
+		std::vector<VDFFInputFile*> segments(paths.size());
+		{
+			ThreadPool pool(std::min((int)paths.size(), 8));
+			for (size_t i = 0; i < paths.size(); i++) {
+				pool.Push([this, &paths, &segments, i] {
+					segments[i] = open_segment(paths[i].c_str(), VDFFInputFileDriver::kOF_SingleFile);
+				});
+			}
+			pool.Wait();
+		}
+
+		size_t i = 0;
+		while (i < segments.size()) {
+			if (!link_segment(segments[i++])) {
 				break;
 			}
-			x++;
+		}
+		// not linked after a failure, the error names the segment that stopped the chain
+		if (i < segments.size()) {
+			DLog(L"VDFFInputFile: {} segments after {} are not appended", segments.size() - i, paths[i - 1]);
+		}
+		for (; i < segments.size(); i++) {
+			delete segments[i];
 		}
 	}
 }
@@ -649,58 +799,147 @@ bool VDXAPIENTRY VDFFInputFile::Append2(const wchar_t* szFile, int flags, IVDXIn
 {
 	if (!szFile) return true;
 
-	VDFFInputFile* head = head_segment ? head_segment : this;
-	VDFFInputFile* last = head;
-	while (last->next_segment) last = last->next_segment;
+	return link_segment(open_segment(szFile, flags));
+}
 
-	VDFFInputFile* f = new VDFFInputFile(mContext);
-	f->head_segment = head;
+VDFFInputFile* VDFFInputFile::open_segment(const wchar_t* szFile, int flags)
+{
+	VDFFSegmentCallbacks* callbacks = new VDFFSegmentCallbacks(mContext);
+	VDFFInputFile* f = new VDFFInputFile(callbacks->context);
+	f->segment_callbacks.reset(callbacks);
+	f->head_segment = head_segment ? head_segment : this;
 	if (flags & VDFFInputFileDriver::kOF_AutoSegmentScan) f->auto_append = true; else f->auto_append = false;
 	if (flags & VDFFInputFileDriver::kOF_SingleFile) f->single_file_mode = true; else f->single_file_mode = false;
 	f->Init(szFile, 0);
+	if (f->m_pFormatCtx) {
+		// the part of initStream that needs no decoder, runs on the pool of do_auto_append
+		f->load_index();
+	}
+
+	return f;
+}
+
+void VDFFInputFile::load_index()
+{
+	const int index = find_stream(m_pFormatCtx, AVMEDIA_TYPE_VIDEO);
+	if (index < 0 || is_image || is_image_list) {
+		return;
+	}
+	AVStream* st = m_pFormatCtx->streams[index];
+	if (avformat_index_get_entries_count(st) >= 2) {
+		return;
+	}
+
+	// try to force loading index, works for FLV and MKV
+	int64_t pos = st->duration;
+	if (pos == AV_NOPTS_VALUE) {
+		pos = get_end_pts(index);
+	}
+	if (pos == AV_NOPTS_VALUE && m_pFormatCtx->duration != AV_NOPTS_VALUE) {
+		pos = av_rescale_q(m_pFormatCtx->duration, av_make_q(1, AV_TIME_BASE), st->time_base);
+	}
+	if (pos == AV_NOPTS_VALUE) {
+		return;
+	}
+	seek_frame(m_pFormatCtx, index, pos, AVSEEK_FLAG_BACKWARD);
+	seek_frame(m_pFormatCtx, index, AV_SEEK_START, AVSEEK_FLAG_BACKWARD);
+}
+
+void VDFFInputFile::close_demuxer()
+{
+	std::lock_guard lock(demuxer_mutex);
+	if (!head_segment || !m_pFormatCtx) {
+		return;
+	}
+	VDFFFilePool::close_input(&m_pFormatCtx);
+	DLog(L"VDFFInputFile: closed the demuxer of {}", m_path);
+}
+
+AVFormatContext* VDFFInputFile::open_demuxer()
+{
+	std::lock_guard lock(demuxer_mutex);
+	if (m_pFormatCtx || !stream_info) {
+		return m_pFormatCtx;
+	}
+
+	// same as in OpenVideoFile, the stream information was found before
+	AVFormatContext* fmt = nullptr;
+	if (VDFFFilePool::Instance().open_input(&fmt, m_path, stream_info->iformat) != 0) {
+		mContext.mpCallbacks->SetError("FFMPEG open failure:\n%s", get_last_av_error().c_str());
+		return nullptr;
+	}
+	fmt->max_index_size = 512 * 1024 * 1024;
+
+	if (VDFFProbeCache::find_stream_info(fmt, stream_info) < 0) {
+		mContext.mpCallbacks->SetError("FFMPEG: Couldn't find stream information of file.");
+		VDFFFilePool::close_input(&fmt);
+		return nullptr;
+	}
+
+	const int st = find_stream(fmt, AVMEDIA_TYPE_VIDEO);
+	if (st != -1) {
+		for (int i = 0; i < (int)fmt->nb_streams; i++) {
+			if (i != st) {
+				fmt->streams[i]->discard = AVDISCARD_ALL;
+			}
+		}
+	}
+
+	m_pFormatCtx = fmt;
+	DLog(L"VDFFInputFile: reopened the demuxer of {}", m_path);
+
+	return m_pFormatCtx;
+}
+
+bool VDFFInputFile::link_segment(VDFFInputFile* f)
+{
+	// the errors of the segment are held until here, the host learns which file stopped appending
+	VDFFSegmentCallbacks* callbacks = f->segment_callbacks.get();
+
+	VDFFInputFile* head = f->head_segment;
+	VDFFInputFile* last = head;
+	while (last->next_segment) last = last->next_segment;
 
 	if (!f->m_pFormatCtx) {
+		callbacks->release(f->m_path);
 		delete f;
 		return false;
 	}
 
 	if (!test_append(head, f)) {
-		mContext.mpCallbacks->SetError("FFMPEG: Couldn't append incompatible formats.");
+		callbacks->SetError("FFMPEG: Couldn't append incompatible formats.");
+		callbacks->release(f->m_path);
 		delete f;
 		return false;
 	}
 
+	// before the segment can be reached, the video and the audio threads pre-warm through it
+	if (!head->segment_prewarm) {
+		head->segment_prewarm = std::make_unique<ThreadPool>(1);
+	}
 	last->next_segment = f;
 	last->next_segment->AddRef();
 
+	head->invalidate_segments();
+
+	// positions are resolved by the head segment, the totals of the other segments are not used
 	if (head->video_source) {
 		if (f->GetVideoSource(0, 0)) {
-			VDFFVideoSource::ConvertInfo& convertInfo = head->video_source->m_convertInfo;
-			f->video_source->SetTargetFormat(convertInfo.req_format, convertInfo.req_dib, head->video_source);
-			VDFFInputFile* f1 = head;
-			while (1) {
-				f1->video_source->m_streamInfo.mInfo.mSampleCount += f->video_source->m_sample_count;
-				f1 = f1->next_segment;
-				if (!f1) break;
-				if (f1 == f) break;
-			}
+			// the target format is set when the segment is opened
+			head->video_source->m_streamInfo.mInfo.mSampleCount += f->video_source->m_sample_count;
 		}
 		else {
 			last->next_segment = nullptr;
+			callbacks->release(f->m_path);
 			f->Release();
 			return false;
 		}
 	}
+	callbacks->release(f->m_path);
 
 	if (head->audio_source) {
 		if (f->GetAudioSource(0, 0)) {
-			VDFFInputFile* f1 = head;
-			while (1) {
-				f1->audio_source->m_streamInfo.mSampleCount += f->audio_source->sample_count;
-				f1 = f1->next_segment;
-				if (!f1) break;
-				if (f1 == f) break;
-			}
+			head->audio_source->m_streamInfo.mSampleCount += f->audio_source->sample_count;
 		}
 		else {
 			// no audio is allowed
@@ -719,37 +958,45 @@ AVFormatContext* VDFFInputFile::OpenVideoFile()
 {
 	std::string ff_path = ConvertWideToUtf8(m_path);
 
-	AVFormatContext* fmt = nullptr;
+	// the context probed by file detection is ready for use
+	AVFormatContext* fmt = head_segment ? nullptr : VDFFProbeCache::Instance().take(m_path);
 	int err = 0;
-	try {
-		err = avformat_open_input(&fmt, ff_path.c_str(), nullptr, nullptr);
-	}
-	catch (const std::system_error& e) {
-		mContext.mpCallbacks->SetError("FFMPEG caught std::system_error: %s\nCode: %d", e.what(), e.code().value());
-		return nullptr;
-	}
-	catch (const std::exception& e) {
-		mContext.mpCallbacks->SetError("FFMPEG caught a general std::exception: %s", e.what());
-		return nullptr;
-	}
-	catch (...) {
-		mContext.mpCallbacks->SetError("FFMPEG caught an unknown exception.");
-		return nullptr;
-	}
+	if (!fmt) {
+		try {
+			if (head_segment) {
+				// appended segments may be many, their file handles are limited
+				err = VDFFFilePool::Instance().open_input(&fmt, m_path);
+			} else {
+				err = VDFFIOBackend::open_input(&fmt, m_path);
+			}
+		}
+		catch (const std::system_error& e) {
+			mContext.mpCallbacks->SetError("FFMPEG caught std::system_error: %s\nCode: %d", e.what(), e.code().value());
+			return nullptr;
+		}
+		catch (const std::exception& e) {
+			mContext.mpCallbacks->SetError("FFMPEG caught a general std::exception: %s", e.what());
+			return nullptr;
+		}
+		catch (...) {
+			mContext.mpCallbacks->SetError("FFMPEG caught an unknown exception.");
+			return nullptr;
+		}
 
-	if (err != 0) {
-		mContext.mpCallbacks->SetError("FFMPEG open failure:\n%s", get_last_av_error().c_str());
-		return nullptr;
-	}
+		if (err != 0) {
+			mContext.mpCallbacks->SetError("FFMPEG open failure:\n%s", get_last_av_error().c_str());
+			return nullptr;
+		}
 
-	// I absolutely do not want index getting condensed
-	fmt->max_index_size = 512 * 1024 * 1024;
+		// I absolutely do not want index getting condensed
+		fmt->max_index_size = 512 * 1024 * 1024;
 
-	err = avformat_find_stream_info(fmt, nullptr);
-	if (err < 0) {
-		mContext.mpCallbacks->SetError("FFMPEG: Couldn't find stream information of file.");
-		avformat_close_input(&fmt);
-		return nullptr;
+		err = avformat_find_stream_info(fmt, nullptr);
+		if (err < 0) {
+			mContext.mpCallbacks->SetError("FFMPEG: Couldn't find stream information of file.");
+			VDFFFilePool::close_input(&fmt);
+			return nullptr;
+		}
 	}
 
 	is_image = false;
@@ -806,13 +1053,16 @@ AVFormatContext* VDFFInputFile::OpenVideoFile()
 	if (is_image && !single_file_mode) {
 		const AVInputFormat* fmt_image2 = av_find_input_format("image2");
 		if (fmt_image2) {
+			const AVInputFormat* fmt_single = fmt->iformat;
 			AVRational r_fr = fmt->streams[0]->r_frame_rate;
-			wchar_t list_path[MAX_PATH];
-			int start, count;
-			if (detect_image_list(list_path, MAX_PATH, &start, &count)) {
+			std::wstring list_path;
+			std::vector<int> numbers;
+			if (detect_image_list(list_path, numbers)) {
+				const int start = numbers.front();
+				const int count = (int)numbers.size();
 				is_image_list = true;
 				auto_append = false;
-				avformat_close_input(&fmt);
+				VDFFFilePool::close_input(&fmt);
 				ff_path = ConvertWideToUtf8(list_path);
 				AVDictionary* options = nullptr;
 				av_dict_set_int(&options, "start_number", start, 0);
@@ -824,18 +1074,26 @@ AVFormatContext* VDFFInputFile::OpenVideoFile()
 				av_dict_free(&options);
 				if (err != 0) {
 					mContext.mpCallbacks->SetError("FFMPEG: Unable to open image sequence.");
-					avformat_close_input(&fmt);
+					VDFFFilePool::close_input(&fmt);
 					return nullptr;
 				}
 				err = avformat_find_stream_info(fmt, nullptr);
 				if (err < 0) {
 					mContext.mpCallbacks->SetError("FFMPEG: Couldn't find stream information of file.");
-					avformat_close_input(&fmt);
+					VDFFFilePool::close_input(&fmt);
 					return nullptr;
 				}
 
 				AVStream& st = *fmt->streams[0];
 				st.nb_frames = count;
+
+				// frames are independent files, decode them in parallel
+				int thread_count = config_image_threads;
+				if (thread_count <= 0) {
+					thread_count = std::min((int)std::thread::hardware_concurrency(), 8);
+				}
+				delete image_sequence;
+				image_sequence = new VDFFImageSequence(list_path, std::move(numbers), fmt_single, st.codecpar, thread_count, config_image_io_threads, config_image_io_depth);
 			}
 		}
 	}
@@ -844,6 +1102,9 @@ AVFormatContext* VDFFInputFile::OpenVideoFile()
 		is_mp4 = true;
 	}
 
+	// before unwanted streams are disabled
+	tail_end_pts = scan_tail(fmt);
+
 	int st = find_stream(fmt, AVMEDIA_TYPE_VIDEO);
 	if (st != -1) {
 		// disable unwanted streams
@@ -864,60 +1125,178 @@ AVFormatContext* VDFFInputFile::OpenVideoFile()
 	return fmt;
 }
 
-bool VDFFInputFile::detect_image_list(wchar_t* dst, int dst_count, int* start, int* count)
+std::vector<int64_t> VDFFInputFile::scan_tail(AVFormatContext* fmt, bool all)
 {
-	const wchar_t* p = GetFileExt(m_path);
-	if (!p) {
-		return false;
+	std::vector<int64_t> end_pts(fmt->nb_streams, AV_NOPTS_VALUE);
+
+	if (is_image || is_image_list || !fmt->pb || !(fmt->pb->seekable & AVIO_SEEKABLE_NORMAL)
+		|| (fmt->iformat->flags & (AVFMT_NOFILE | AVFMT_NO_BYTE_SEEK))) {
+		return end_pts;
+	}
+
+	// only streams whose length would be guessed
+	std::vector<bool> wanted(fmt->nb_streams);
+	int wanted_count = 0;
+	for (int i = 0; i < (int)fmt->nb_streams; i++) {
+		const AVStream* st = fmt->streams[i];
+		const AVMediaType type = st->codecpar->codec_type;
+		if ((type == AVMEDIA_TYPE_VIDEO || type == AVMEDIA_TYPE_AUDIO)
+			&& (all || st->duration == AV_NOPTS_VALUE || fmt->duration_estimation_method == AVFMT_DURATION_FROM_BITRATE)) {
+			wanted[i] = true;
+			wanted_count++;
+		}
+	}
+	const int64_t file_size = avio_size(fmt->pb);
+	if (!wanted_count || file_size <= 0) {
+		return end_pts;
+	}
+
+	AVPacket* pkt = av_packet_alloc();
+	int found_count = 0;
+	// read the last 2 MB, retry once with 8 MB if some stream has no packet there,
+	// a stream that is still missing keeps the guessed length
+	for (int64_t window = 2 * 1024 * 1024; found_count < wanted_count && window <= 8 * 1024 * 1024; window *= 4) {
+		const int64_t pos = std::max<int64_t>(0, file_size - window);
+		if (av_seek_frame(fmt, -1, pos, AVSEEK_FLAG_BYTE) < 0) {
+			break;
+		}
+		while (av_read_frame(fmt, pkt) == 0) {
+			const int i = pkt->stream_index;
+			if (i < (int)wanted.size() && wanted[i] && pkt->pts != AV_NOPTS_VALUE) {
+				const int64_t end = pkt->pts + std::max<int64_t>(pkt->duration, 0);
+				if (end_pts[i] == AV_NOPTS_VALUE) {
+					found_count++;
+				}
+				if (end_pts[i] == AV_NOPTS_VALUE || end > end_pts[i]) {
+					end_pts[i] = end;
+				}
+			}
+			av_packet_unref(pkt);
+		}
+		if (pos == 0) {
+			break;
+		}
+	}
+	av_packet_free(&pkt);
+
+	// back to the start of the stream that the video source reads from this context
+	const int st = find_stream(fmt, AVMEDIA_TYPE_VIDEO);
+	if (st != -1) {
+		seek_frame(fmt, st, AV_SEEK_START, AVSEEK_FLAG_BACKWARD);
+	} else {
+		av_seek_frame(fmt, -1, 0, AVSEEK_FLAG_BYTE);
+	}
+
+	DLog(L"VDFFInputFile: tail scan found the end of {} of {} streams", found_count, wanted_count);
+
+	return end_pts;
+}
+
+bool VDFFInputFile::check_growth(int& seen)
+{
+	if (growth_check && !head_segment && !next_segment) {
+		const uint64_t now = GetTickCount64();
+		// the host and the audio tracks call this from different threads, one of them starts the scan
+		if (now - m_lastGrowthCheck >= uint64_t(config_growing_check) * 1000 && !growth_busy.exchange(true)) {
+			m_lastGrowthCheck = now;
+			growth_check->Push([this] { scan_growth(); });
+		}
 	}
 
-	int digit0 = -1;
-	int digit1 = -1;
+	const int count = growth_count;
+	if (seen == count) {
+		return false;
+	}
+	seen = count;
+	return true;
+}
 
-	while (p > m_path.c_str()) {
-		p--;
-		int c = *p;
-		if (c == '\\' || c == '/') break;
-		if (c >= '0' && c <= '9') {
-			if (digit0 == -1) {
-				digit0 = int(p - m_path.c_str());
-				digit1 = digit0;
+void VDFFInputFile::scan_growth()
+{
+	const int64_t size = get_file_size(m_path);
+	// a separate context, the demuxers of the sources keep their position
+	AVFormatContext* fmt = nullptr;
+	// compared with the copy, the video may be demuxing from m_pFormatCtx
+	const AVFormatContext* info = stream_info;
+	if (info && size > m_fileSize && VDFFIOBackend::open_input(&fmt, m_path, info->iformat) == 0) {
+		// the streams of mpegts and other formats without a header are probed again
+		bool same = avformat_find_stream_info(fmt, nullptr) >= 0 && fmt->nb_streams >= info->nb_streams;
+		for (unsigned i = 0; same && i < info->nb_streams; i++) {
+			same = fmt->streams[i]->codecpar->codec_type == info->streams[i]->codecpar->codec_type
+				&& fmt->streams[i]->codecpar->codec_id == info->streams[i]->codecpar->codec_id;
+		}
+		if (same) {
+			std::vector<int64_t> end_pts = scan_tail(fmt, true);
+			end_pts.resize(info->nb_streams);
+			{
+				std::lock_guard lock(growth_mutex);
+				tail_end_pts = std::move(end_pts);
 			}
-			else digit0--;
+			m_fileSize = size;
+			growth_count++;
+			DLog(L"VDFFInputFile: {} has grown to {} bytes", m_path, size);
 		}
-		else if (digit0 != -1) break;
+		VDFFFilePool::close_input(&fmt);
 	}
+	growth_busy = false;
+}
 
-	if (digit0 == -1) return false;
+std::shared_ptr<VDFFDemuxHub> VDFFInputFile::get_audio_hub()
+{
+	if (!audio_hub_opened) {
+		audio_hub_opened = true;
+		if (config_shared_demux && !is_image && !is_image_list) {
+			audio_hub.reset(VDFFDemuxHub::Open(m_path, head_segment != nullptr, stream_info));
+		}
+	}
+	return audio_hub;
+}
 
-	char start_buf[128];
-	char* s = start_buf;
-	for (int i = digit0; i <= digit1; i++) {
-		int c = m_path[i];
-		*s = c;
-		s++;
+bool VDFFInputFile::detect_image_list(std::wstring& pattern, std::vector<int>& numbers)
+{
+	const wchar_t* ext = GetFileExt(m_path);
+	ImageListName name;
+	if (!ext || !ParseImageListName(m_path, ext - m_path.c_str(), name)) {
+		return false;
 	}
-	*s = 0;
 
-	wchar_t buf[20];
-	swprintf_s(buf, L"%%0%dd", digit1 - digit0 + 1);
+	const size_t digit1 = name.digit0 + name.width;
+	pattern = std::format(L"{}%0{}d{}", std::wstring_view(m_path).substr(0, name.digit0), name.width, m_path.c_str() + digit1);
 
-	wcsncpy_s(dst, dst_count, m_path.c_str(), digit0);
-	dst[digit0] = 0;
-	wcscat_s(dst, dst_count, buf);
-	wcscat_s(dst, dst_count, m_path.c_str() + digit1 + 1);
+	// one directory enumeration instead of a filesystem query per frame
+	const std::wstring_view dir(m_path.c_str(), name.name0);
+	const std::wstring_view prefix(m_path.c_str() + name.name0, name.digit0 - name.name0);
+	const std::wstring_view suffix(m_path.c_str() + digit1);
 
-	sscanf_s(start_buf, "%d", start);
-	int n = 0;
+	std::wstring mask = std::format(L"{}{}*{}", dir, prefix, suffix);
+	std::vector<int> found;
 
-	wchar_t test[MAX_PATH];
-	while (1) {
-		swprintf_s(test, dst, *start + n);
-		if (GetFileAttributesW(test) == (DWORD)-1) break;
-		n++;
+	WIN32_FIND_DATAW fd;
+	HANDLE hFind = FindFirstFileExW(mask.c_str(), FindExInfoBasic, &fd, FindExSearchNameMatch, nullptr, FIND_FIRST_EX_LARGE_FETCH);
+	if (hFind != INVALID_HANDLE_VALUE) {
+		do {
+			if (fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+				continue;
+			}
+			const std::wstring_view file(fd.cFileName);
+			if (file.size() < prefix.size() + suffix.size()) {
+				continue;
+			}
+			if (_wcsnicmp(file.data(), prefix.data(), prefix.size()) != 0
+				|| _wcsicmp(file.data() + file.size() - suffix.size(), suffix.data()) != 0) {
+				continue;
+			}
+			const int n = ParseImageListNumber(file.substr(prefix.size(), file.size() - prefix.size() - suffix.size()), name.width);
+			if (n >= name.start) {
+				found.emplace_back(n);
+			}
+		} while (FindNextFileW(hFind, &fd));
+		FindClose(hFind);
 	}
 
-	*count = n;
+	numbers = MapImageList(found, name.start, max_image_list_gap);
+
+	DLog(L"detect_image_list: {} files found, {} frames", found.size(), numbers.size());
 
 	return true;
 }
@@ -938,7 +1317,7 @@ bool VDFFInputFile::GetVideoSource(int index, IVDXVideoSource** ppVS)
 {
 	if (ppVS) *ppVS = nullptr;
 
-	if (!m_pFormatCtx) return false;
+	if (!open_demuxer()) return false;
 	if (index != 0) return false;
 
 	index = find_stream(m_pFormatCtx, AVMEDIA_TYPE_VIDEO);
@@ -947,13 +1326,16 @@ bool VDFFInputFile::GetVideoSource(int index, IVDXVideoSource** ppVS)
 
 	VDFFVideoSource* pVS = new VDFFVideoSource(mContext);
 
-	if (pVS->initStream(this, index) < 0) {
+	// appended segments are opened on first access, see find_video_segment
+	const int ret = head_segment ? pVS->initSegment(this, index) : pVS->initStream(this, index);
+	if (ret < 0) {
 		delete pVS;
 		return false;
 	}
 
 	video_source = pVS;
 	video_source->AddRef();
+	invalidate_segments();
 
 	if (ppVS) {
 		*ppVS = pVS;
@@ -971,7 +1353,7 @@ bool VDFFInputFile::GetAudioSource(int index, IVDXAudioSource** ppAS)
 {
 	if (ppAS) *ppAS = nullptr;
 
-	if (!m_pFormatCtx) return false;
+	if (!open_demuxer()) return false;
 
 	int s_index = find_stream(m_pFormatCtx, AVMEDIA_TYPE_AUDIO);
 	if (index > 0) {
@@ -995,7 +1377,8 @@ bool VDFFInputFile::GetAudioSource(int index, IVDXAudioSource** ppAS)
 
 	VDFFAudioSource* pAS = new VDFFAudioSource(mContext);
 
-	if (pAS->initStream(this, s_index) < 0) {
+	const int ret = head_segment ? pAS->initSegment(this, s_index) : pAS->initStream(this, s_index);
+	if (ret < 0) {
 		delete pAS;
 		return false;
 	}
@@ -1008,6 +1391,7 @@ bool VDFFInputFile::GetAudioSource(int index, IVDXAudioSource** ppAS)
 	if (index == 0 && !audio_source) {
 		audio_source = pAS;
 		audio_source->AddRef();
+		invalidate_segments();
 	}
 
 	// delete unused
@@ -1023,6 +1407,84 @@ bool VDFFInputFile::GetAudioSource(int index, IVDXAudioSource** ppAS)
 	return true;
 }
 
+void VDFFInputFile::invalidate_segments()
+{
+	VDFFInputFile* head = head_segment ? head_segment : this;
+	std::lock_guard lock(head->segment_mutex);
+	head->segment_table_valid = false;
+}
+
+void VDFFInputFile::build_segment_table()
+{
+	segment_video.clear();
+	segment_frames.clear();
+	segment_audio.clear();
+	segment_samples.clear();
+
+	// a segment without the stream ends the chain
+	int64_t pos = 0;
+	for (VDFFInputFile* f = next_segment; f && f->video_source; f = f->next_segment) {
+		segment_video.emplace_back(f->video_source);
+		segment_frames.emplace_back(pos);
+		pos += f->video_source->m_sample_count;
+	}
+	pos = 0;
+	for (VDFFInputFile* f = next_segment; f && f->audio_source; f = f->next_segment) {
+		segment_audio.emplace_back(f->audio_source);
+		segment_samples.emplace_back(pos);
+		pos += f->audio_source->sample_count;
+	}
+
+	segment_table_valid = true;
+}
+
+VDFFVideoSource* VDFFInputFile::find_video_segment(int64_t& pos)
+{
+	VDFFVideoSource* v = nullptr;
+	if (head_segment) {
+		v = next_segment ? next_segment->video_source : nullptr;
+	} else {
+		std::lock_guard lock(segment_mutex);
+		if (!segment_table_valid) {
+			build_segment_table();
+		}
+		v = FindSegment(segment_video, segment_frames, pos);
+	}
+	// the stream of the segment is opened when it is first handed out
+	if (v && !v->init_deferred()) {
+		return nullptr;
+	}
+	return v;
+}
+
+VDFFAudioSource* VDFFInputFile::find_audio_segment(int64_t& pos)
+{
+	VDFFAudioSource* a = nullptr;
+	if (head_segment) {
+		a = next_segment ? next_segment->audio_source : nullptr;
+	} else {
+		std::lock_guard lock(segment_mutex);
+		if (!segment_table_valid) {
+			build_segment_table();
+		}
+		a = FindSegment(segment_audio, segment_samples, pos);
+	}
+	if (a && !a->init_deferred()) {
+		return nullptr;
+	}
+	return a;
+}
+
+void VDFFInputFile::prewarm_segment(std::function<void()> task)
+{
+	// created by link_segment
+	VDFFInputFile* head = head_segment ? head_segment : this;
+	head->segment_prewarm->Push([task = std::move(task)] {
+		VDFFSegmentCallbacks::t_prewarm = true;
+		task();
+	});
+}
+
 int seek_frame(AVFormatContext* s, int stream_index, int64_t timestamp, int flags)
 {
 	int ret = av_seek_frame(s, stream_index, timestamp, flags);
@@ -10,6 +10,8 @@
 #define __STDC_LIMIT_MACROS
 #include <vd2/plugin/vdinputdriver.h>
 #include <vd2/VDXFrame/Unknown.h>
+#include <atomic>
+#include <mutex>
 
 extern "C"
 {
@@ -18,6 +20,10 @@ extern "C"
 
 class VDFFVideoSource;
 class VDFFAudioSource;
+class VDFFImageSequence;
+class VDFFDemuxHub;
+class VDFFSegmentCallbacks;
+class ThreadPool;
 
 class VDFFInputFileDriver : public vdxunknown<IVDXInputFileDriver>
 {
@@ -108,11 +114,39 @@ public:
 	bool cfg_disable_cache = false;
 
 	AVFormatContext* m_pFormatCtx = nullptr;
+	// the stream information of m_pFormatCtx for other threads, which must not touch the context
+	// the video demuxes from, see VDFFProbeCache::copy_stream_info
+	AVFormatContext* stream_info = nullptr;
 	VDFFVideoSource* video_source = nullptr;
 	VDFFAudioSource* audio_source = nullptr;
 	VDFFInputFile*   next_segment = nullptr;
 	VDFFInputFile*   head_segment = nullptr;
 
+	VDFFImageSequence* image_sequence = nullptr;
+	std::shared_ptr<VDFFDemuxHub> audio_hub; // shared by the audio sources
+	bool audio_hub_opened = false;
+	std::unique_ptr<VDFFSegmentCallbacks> segment_callbacks; // error reporting of appended segments
+	// an idle appended segment closes m_pFormatCtx, see close_demuxer
+	std::mutex demuxer_mutex;
+
+	// sources of the following segments and their start positions relative to the end of this file,
+	// only the head segment keeps them
+	std::vector<VDFFVideoSource*> segment_video;
+	std::vector<int64_t> segment_frames;
+	std::vector<VDFFAudioSource*> segment_audio;
+	std::vector<int64_t> segment_samples;
+	bool segment_table_valid = false;
+	std::mutex segment_mutex; // guards the table, the host and the audio threads look up segments
+	std::unique_ptr<ThreadPool> segment_prewarm; // decodes the start of the next segment, head segment only
+	std::vector<int64_t> tail_end_pts; // per stream, AV_NOPTS_VALUE unless found by scan_tail
+	// files that are still being written, see check_growth
+	mutable std::mutex growth_mutex; // guards tail_end_pts after the file is opened
+	std::unique_ptr<ThreadPool> growth_check; // scans the new end of the file
+	std::atomic<int> growth_count = 0;
+	std::atomic<bool> growth_busy = false;
+	std::atomic<uint64_t> m_lastGrowthCheck = 0;
+	int64_t m_fileSize = 0; // the scanning thread only after Init
+
 	int VDXAPIENTRY AddRef() override {
 		return vdxunknown<IVDXInputFile>::AddRef();
 	}
@@ -152,8 +186,37 @@ public:
 	AVFormatContext* getContext(void) { return m_pFormatCtx; }
 	int find_stream(AVFormatContext* fmt, AVMediaType type);
 	AVFormatContext* OpenVideoFile();
-	bool detect_image_list(wchar_t* dst, int dst_count, int* start, int* count);
+	// end of the last packet of each stream, all = true also for streams with a known duration
+	std::vector<int64_t> scan_tail(AVFormatContext* fmt, bool all = false);
+	// end of the last packet in stream time base, known only for streams without exact duration
+	int64_t get_end_pts(int stream) const
+	{
+		std::lock_guard lock(growth_mutex);
+		return stream < (int)tail_end_pts.size() ? tail_end_pts[stream] : AV_NOPTS_VALUE;
+	}
+	// starts a check for appended data every few seconds, the new end is scanned on a thread,
+	// returns true when there was a growth not yet seen by the caller
+	bool check_growth(int& seen);
+	void scan_growth();
+	std::shared_ptr<VDFFDemuxHub> get_audio_hub();
+	bool detect_image_list(std::wstring& pattern, std::vector<int>& numbers);
 	void do_auto_append(const wchar_t* szFile);
+	VDFFInputFile* open_segment(const wchar_t* szFile, int flags);
+	// loads the index of the video stream, so an appended segment knows its frame count
+	void load_index();
+	// closes the demuxer of an idle appended segment, the video source keeps what it needs of the stream
+	void close_demuxer();
+	// opens the demuxer again after close_demuxer, nullptr on failure
+	AVFormatContext* open_demuxer();
+	void invalidate_segments();
+	// expects segment_mutex
+	void build_segment_table();
+	// the following segment holding pos (relative to the end of this file), pos becomes local to it
+	VDFFVideoSource* find_video_segment(int64_t& pos);
+	VDFFAudioSource* find_audio_segment(int64_t& pos);
+	bool link_segment(VDFFInputFile* f);
+	// runs the task on the pre-warming thread of the head segment
+	void prewarm_segment(std::function<void()> task);
 
 protected:
 	const VDXInputDriverContext& mContext;
@@ -0,0 +1,51 @@
+/*
+ * Copyright (C) 2026 v0lt
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "stdafx.h"
+
+#include "PerfCounters.h"
+
+static int64_t TicksToMicroseconds(const int64_t ticks)
+{
+	static const int64_t freq = [] {
+		LARGE_INTEGER f;
+		QueryPerformanceFrequency(&f);
+		return f.QuadPart;
+	}();
+
+	return ticks / freq * 1000000 + ticks % freq * 1000000 / freq;
+}
+
+void PerfCountersFromTicks(VDFFPerfCounters& dst, const VDFFPerfCounters& src)
+{
+	const uint32_t size = std::min(dst.size, (uint32_t)sizeof(VDFFPerfCounters));
+
+	VDFFPerfCounters c = src;
+	c.size = size;
+	c.decode_time  = TicksToMicroseconds(src.decode_time);
+	c.convert_time = TicksToMicroseconds(src.convert_time);
+	c.copy_time    = TicksToMicroseconds(src.copy_time);
+
+	memcpy(&dst, &c, size);
+}
+
+std::string PerfCountersToJson(const VDFFPerfCounters& c)
+{
+	return std::format(
+		"{{\"cache_hits\":{},\"cache_misses\":{},\"seeks\":{},\"decoded\":{},\"delivered\":{},\"preroll_wasted\":{},"
+		"\"decode_time_us\":{},\"convert_time_us\":{},\"copy_time_us\":{},\"bytes_read\":{},\"cache_bytes_peak\":{}}}",
+		c.cache_hits, c.cache_misses, c.seeks, c.decoded, c.delivered, c.preroll_wasted,
+		c.decode_time, c.convert_time, c.copy_time, c.bytes_read, c.cache_bytes_peak);
+}
+
+int CopyJson(const std::string& json, char* buf, int buf_size)
+{
+	const int size = (int)json.size() + 1;
+	if (buf && buf_size > 0) {
+		strncpy_s(buf, buf_size, json.c_str(), _TRUNCATE);
+	}
+	return size;
+}
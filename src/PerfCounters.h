@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2026 v0lt
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+
+#include <vd2/plugin/vdplugin.h>
+
+// Counters of a video or audio source, cumulative since the source was opened.
+// Video sources count frames, audio sources count samples. Times are in microseconds.
+struct VDFFPerfCounters {
+	uint32_t size = sizeof(VDFFPerfCounters);
+
+	int64_t cache_hits       = 0;
+	int64_t cache_misses     = 0;
+	int64_t seeks            = 0;
+	int64_t decoded          = 0;
+	int64_t delivered        = 0;
+	int64_t preroll_wasted   = 0; // decoded before the requested position after a seek
+	int64_t decode_time      = 0;
+	int64_t convert_time     = 0; // sws_scale, swr_convert
+	int64_t copy_time        = 0;
+	int64_t bytes_read       = 0; // compressed data of the stream
+	int64_t cache_bytes_peak = 0;
+};
+
+// Available with AsInterface from video and audio sources.
+class IVDFFPerfCounters : public IVDXUnknown {
+public:
+	enum { kIID = VDXMAKEFOURCC('F', 'F', 'p', 'c') };
+	virtual void VDXAPIENTRY GetPerfCounters(VDFFPerfCounters& counters) = 0;
+	virtual void VDXAPIENTRY ResetPerfCounters() = 0;
+	// writes a JSON object, returns the required buffer size including the terminating zero
+	virtual int  VDXAPIENTRY GetPerfCountersJson(char* buf, int buf_size) = 0;
+};
+
+// Internally the times are kept in QueryPerformanceCounter ticks.
+
+inline int64_t GetPerfTicks()
+{
+	LARGE_INTEGER t;
+	QueryPerformanceCounter(&t);
+	return t.QuadPart;
+}
+
+class PerfTimer
+{
+	int64_t& m_ticks;
+	const int64_t m_start;
+
+public:
+	PerfTimer(int64_t& ticks) : m_ticks(ticks), m_start(GetPerfTicks()) {}
+	~PerfTimer() { m_ticks += GetPerfTicks() - m_start; }
+};
+
+// converts the internal counters for the caller
+void PerfCountersFromTicks(VDFFPerfCounters& dst, const VDFFPerfCounters& src);
+std::string PerfCountersToJson(const VDFFPerfCounters& counters);
+int CopyJson(const std::string& json, char* buf, int buf_size);
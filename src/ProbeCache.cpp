@@ -0,0 +1,225 @@
+/*
+ * Copyright (C) 2026 v0lt
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "stdafx.h"
+
+#include "ProbeCache.h"
+#include "FilePool.h"
+#include "IOBackend.h"
+#include "Helper.h"
+
+extern HINSTANCE hInstance;
+
+// detection and Init follow each other, a context that waits longer is not going to be used
+const uint64_t probe_ttl = 10000;
+const size_t max_entries = 4;
+
+static bool get_file_stamp(const std::wstring& path, int64_t& size, FILETIME& write_time)
+{
+	WIN32_FILE_ATTRIBUTE_DATA data;
+	if (!GetFileAttributesExW(path.c_str(), GetFileExInfoStandard, &data)) {
+		return false;
+	}
+	size = ((int64_t)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+	write_time = data.ftLastWriteTime;
+	return true;
+}
+
+static VDFFProbeCache* s_cache = nullptr;
+
+VDFFProbeCache& VDFFProbeCache::Instance()
+{
+	// never destroyed by the runtime, see Shutdown
+	static VDFFProbeCache* cache = new VDFFProbeCache;
+	return *cache;
+}
+
+VDFFProbeCache::VDFFProbeCache()
+{
+	TP_CALLBACK_ENVIRON env;
+	InitializeThreadpoolEnvironment(&env);
+	// the library stays loaded while a callback is pending
+	SetThreadpoolCallbackLibrary(&env, hInstance);
+	m_timer = CreateThreadpoolTimer(&TimerProc, this, &env);
+	DestroyThreadpoolEnvironment(&env);
+
+	s_cache = this;
+}
+
+void VDFFProbeCache::Shutdown()
+{
+	if (!s_cache) {
+		return;
+	}
+	// called under the loader lock, nothing here may wait or close a context.
+	// a pending callback would keep the library loaded, so none is running,
+	// cancelling the timer is enough and the cached contexts are left to the process
+	if (s_cache->m_timer) {
+		SetThreadpoolTimer(s_cache->m_timer, nullptr, 0, 0);
+		CloseThreadpoolTimer(s_cache->m_timer);
+		s_cache->m_timer = nullptr;
+	}
+}
+
+void CALLBACK VDFFProbeCache::TimerProc(PTP_CALLBACK_INSTANCE instance, void* context, PTP_TIMER timer)
+{
+	VDFFProbeCache* cache = (VDFFProbeCache*)context;
+	const uint64_t now = GetTickCount64();
+
+	std::lock_guard lock(cache->m_mutex);
+	cache->drop_expired(now);
+	cache->set_timer(now);
+}
+
+void VDFFProbeCache::set_timer(uint64_t now)
+{
+	if (!m_timer || m_entries.empty()) {
+		return;
+	}
+	const uint64_t expires = m_entries.back().time + probe_ttl;
+	const uint64_t wait = (expires > now) ? expires - now : 0;
+
+	// negative is relative, in 100 ns units
+	ULARGE_INTEGER due;
+	due.QuadPart = (ULONGLONG)(-(LONGLONG)(wait + 10) * 10000);
+	FILETIME ft = { due.LowPart, due.HighPart };
+	SetThreadpoolTimer(m_timer, &ft, 0, 100);
+}
+
+void VDFFProbeCache::drop_expired(uint64_t now)
+{
+	std::erase_if(m_entries, [&](Entry& e) {
+		if (now - e.time < probe_ttl) {
+			return false;
+		}
+		VDFFFilePool::close_input(&e.fmt);
+		return true;
+	});
+}
+
+void VDFFProbeCache::put(const std::wstring& path, AVFormatContext* fmt)
+{
+	Entry entry;
+	// a read-ahead thread or a file loaded into memory is too much to keep for a file that may only be previewed
+	if (VDFFIOBackend::holds_data(fmt->pb) || !get_file_stamp(path, entry.size, entry.write_time)) {
+		VDFFFilePool::close_input(&fmt);
+		return;
+	}
+	entry.path = path;
+	entry.fmt = fmt;
+	entry.time = GetTickCount64();
+
+	std::lock_guard lock(m_mutex);
+	drop_expired(entry.time);
+	std::erase_if(m_entries, [&](Entry& e) {
+		if (e.path != path) {
+			return false;
+		}
+		VDFFFilePool::close_input(&e.fmt);
+		return true;
+	});
+	m_entries.emplace_front(std::move(entry));
+	while (m_entries.size() > max_entries) {
+		VDFFFilePool::close_input(&m_entries.back().fmt);
+		m_entries.pop_back();
+	}
+	set_timer(entry.time);
+}
+
+AVFormatContext* VDFFProbeCache::take(const std::wstring& path)
+{
+	Entry entry;
+	{
+		std::lock_guard lock(m_mutex);
+		drop_expired(GetTickCount64());
+		auto it = std::find_if(m_entries.begin(), m_entries.end(), [&](const Entry& e) { return e.path == path; });
+		if (it == m_entries.end()) {
+			return nullptr;
+		}
+		entry = std::move(*it);
+		m_entries.erase(it);
+	}
+
+	int64_t size;
+	FILETIME write_time;
+	if (!get_file_stamp(path, size, write_time) || size != entry.size || CompareFileTime(&write_time, &entry.write_time) != 0) {
+		DLog(L"VDFFProbeCache: {} has changed since probing", path);
+		VDFFFilePool::close_input(&entry.fmt);
+		return nullptr;
+	}
+
+	// the state is the same as after avformat_find_stream_info in the caller
+	return entry.fmt;
+}
+
+int VDFFProbeCache::find_stream_info(AVFormatContext* fmt, const AVFormatContext* probed)
+{
+	bool same = probed
+		&& probed->iformat == fmt->iformat
+		&& probed->nb_streams == fmt->nb_streams
+		// streams of such formats are found only while reading packets
+		&& !(fmt->ctx_flags & AVFMTCTX_NOHEADER);
+
+	for (unsigned i = 0; same && i < fmt->nb_streams; i++) {
+		// the header must already identify every stream
+		const AVCodecParameters* par = fmt->streams[i]->codecpar;
+		const AVCodecParameters* src = probed->streams[i]->codecpar;
+		same = par->codec_type == src->codec_type && par->codec_id == src->codec_id && par->codec_id != AV_CODEC_ID_NONE;
+	}
+	if (!same) {
+		return avformat_find_stream_info(fmt, nullptr);
+	}
+
+	return copy_streams(fmt, probed);
+}
+
+AVFormatContext* VDFFProbeCache::copy_stream_info(const AVFormatContext* fmt)
+{
+	AVFormatContext* copy = avformat_alloc_context();
+	if (!copy) {
+		return nullptr;
+	}
+	// never opened, avformat_free_context does not close it
+	copy->iformat   = fmt->iformat;
+	copy->ctx_flags = fmt->ctx_flags;
+	for (unsigned i = 0; i < fmt->nb_streams; i++) {
+		AVStream* st = avformat_new_stream(copy, nullptr);
+		if (!st) {
+			avformat_free_context(copy);
+			return nullptr;
+		}
+		st->time_base = fmt->streams[i]->time_base;
+	}
+	if (copy_streams(copy, fmt) < 0) {
+		avformat_free_context(copy);
+		return nullptr;
+	}
+
+	return copy;
+}
+
+int VDFFProbeCache::copy_streams(AVFormatContext* fmt, const AVFormatContext* src)
+{
+	for (unsigned i = 0; i < fmt->nb_streams; i++) {
+		AVStream* st = fmt->streams[i];
+		const AVStream* ss = src->streams[i];
+		int ret = avcodec_parameters_copy(st->codecpar, ss->codecpar);
+		if (ret < 0) {
+			return ret;
+		}
+		st->start_time          = ss->start_time;
+		st->duration            = ss->duration;
+		st->nb_frames           = ss->nb_frames;
+		st->r_frame_rate        = ss->r_frame_rate;
+		st->avg_frame_rate      = ss->avg_frame_rate;
+		st->sample_aspect_ratio = ss->sample_aspect_ratio;
+	}
+	fmt->start_time = src->start_time;
+	fmt->duration   = src->duration;
+	fmt->bit_rate   = src->bit_rate;
+
+	return 0;
+}
@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2026 v0lt
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+
+#include <list>
+#include <mutex>
+#include <string>
+
+extern "C"
+{
+#include <libavformat/avformat.h>
+}
+
+// Short-lived cache of probed input contexts.
+// File detection opens the file and finds its stream information, then Init
+// takes the same context instead of probing again. Contexts that are not taken
+// within a few seconds are closed by a timer, those whose file has changed are not used.
+class VDFFProbeCache
+{
+public:
+	static VDFFProbeCache& Instance();
+	// stops the timer when the library is unloaded, the cached contexts are not closed
+	static void Shutdown();
+
+	// takes ownership of a context after avformat_find_stream_info
+	void put(const std::wstring& path, AVFormatContext* fmt);
+	// the caller owns the result, nullptr if there is no fresh context for the path
+	AVFormatContext* take(const std::wstring& path);
+
+	// avformat_find_stream_info, unless the stream information can be copied
+	// from probed, an already probed context of the same file
+	static int find_stream_info(AVFormatContext* fmt, const AVFormatContext* probed);
+	// a context without a demuxer that only holds the stream information of fmt, for find_stream_info,
+	// free it with avformat_free_context, nullptr if out of memory
+	static AVFormatContext* copy_stream_info(const AVFormatContext* fmt);
+
+private:
+	struct Entry {
+		std::wstring path;
+		AVFormatContext* fmt = nullptr;
+		uint64_t time = 0; // GetTickCount64() of put
+		int64_t size  = 0;
+		FILETIME write_time = {};
+	};
+
+	std::mutex m_mutex;
+	std::list<Entry> m_entries; // most recent first
+	PTP_TIMER m_timer = nullptr;
+
+	VDFFProbeCache();
+
+	static int copy_streams(AVFormatContext* fmt, const AVFormatContext* src);
+
+	void drop_expired(uint64_t now);
+	// the timer fires when the oldest entry expires, expects m_mutex
+	void set_timer(uint64_t now);
+	static void CALLBACK TimerProc(PTP_CALLBACK_INSTANCE instance, void* context, PTP_TIMER timer);
+};
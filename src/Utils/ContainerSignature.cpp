@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2026 v0lt
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// built without the precompiled header, the tests compile this file too
+
+#include "ContainerSignature.h"
+#include <algorithm>
+#include <cstring>
+
+static bool find_bytes(const uint8_t* data, int32_t size, const void* pattern, int32_t pattern_size)
+{
+	for (int32_t i = 0; i + pattern_size <= size; i++) {
+		if (memcmp(data + i, pattern, pattern_size) == 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
+const char* FindContainerSignature(const void* header, int32_t size)
+{
+	if (!header || size < 16) {
+		return nullptr;
+	}
+	const uint8_t* p = (const uint8_t*)header;
+	const char* name = nullptr;
+
+	const uint8_t ebml_id[] = { 0x1A, 0x45, 0xDF, 0xA3 };
+	const uint8_t mxf_key[] = { 0x06, 0x0E, 0x2B, 0x34, 0x02, 0x05, 0x01, 0x01, 0x0D, 0x01, 0x02, 0x01, 0x01, 0x02 };
+
+	if (memcmp(p, ebml_id, sizeof(ebml_id)) == 0) {
+		// the DocType element is near the start of the EBML header
+		const int32_t n = std::min(size, 64);
+		if (find_bytes(p, n, "matroska", 8) || find_bytes(p, n, "webm", 4)) {
+			name = "matroska,webm";
+		}
+	}
+	else if (memcmp(p, "FLV\x01", 4) == 0 && p[5] == 0 && p[6] == 0 && p[7] == 0 && p[8] >= 9) {
+		name = "flv";
+	}
+	else if (size >= 25 && memcmp(p, "nut/multimedia container", 25) == 0) {
+		name = "nut";
+	}
+	else if (memcmp(p, "YUV4MPEG2 ", 10) == 0) {
+		name = "yuv4mpegpipe";
+	}
+	else if (memcmp(p, "OggS", 4) == 0 && p[4] == 0) {
+		name = "ogg";
+	}
+	else if (memcmp(p, mxf_key, sizeof(mxf_key)) == 0) {
+		name = "mxf";
+	}
+	else {
+		// MPEG-TS (188) or M2TS (192 with a 4 byte prefix), the sync byte must repeat
+		const int sizes[] = { 188, 192 };
+		for (const int ts_size : sizes) {
+			const int offset = ts_size - 188;
+			const int count = (size - offset) / ts_size;
+			if (count < 5) {
+				continue;
+			}
+			int i = 0;
+			while (i < count && p[offset + i * ts_size] == 0x47) {
+				i++;
+			}
+			if (i == count) {
+				name = "mpegts";
+				break;
+			}
+		}
+	}
+
+	return name;
+}
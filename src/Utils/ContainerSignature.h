@@ -0,0 +1,13 @@
+/*
+ * Copyright (C) 2026 v0lt
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+
+#include <cstdint>
+
+// The FFmpeg name of a container that is recognized by the signature at the start of the file,
+// nullptr for other files. size is the count of bytes in header.
+const char* FindContainerSignature(const void* header, int32_t size);
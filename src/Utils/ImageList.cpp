@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2026 v0lt
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// built without the precompiled header, the tests compile this file too
+
+#include "ImageList.h"
+#include <algorithm>
+
+bool ParseImageListName(std::wstring_view path, size_t ext, ImageListName& name)
+{
+	size_t p = ext;
+	size_t digit0 = std::wstring_view::npos;
+	size_t digit1 = std::wstring_view::npos;
+
+	while (p > 0) {
+		p--;
+		const wchar_t c = path[p];
+		if (c == '\\' || c == '/') break;
+		if (c >= '0' && c <= '9') {
+			if (digit1 == std::wstring_view::npos) {
+				digit1 = p;
+			}
+			digit0 = p;
+		}
+		else if (digit1 != std::wstring_view::npos) break;
+	}
+
+	if (digit1 == std::wstring_view::npos) return false;
+
+	const int width = int(digit1 - digit0 + 1);
+	if (width > 9) return false;
+
+	const size_t slash = path.find_last_of(L"\\/", digit0);
+	name.name0 = (slash == std::wstring_view::npos) ? 0 : slash + 1;
+	name.digit0 = digit0;
+	name.width = width;
+	name.start = 0;
+	for (size_t i = digit0; i <= digit1; i++) {
+		name.start = name.start * 10 + (path[i] - '0');
+	}
+
+	return true;
+}
+
+int ParseImageListNumber(std::wstring_view digits, int width)
+{
+	// longer only without leading zeros, as "%0Nd" prints larger numbers
+	if (digits.empty() || digits.size() < (size_t)width || digits.size() > 9
+		|| (digits.size() > (size_t)width && digits[0] == '0')) {
+		return -1;
+	}
+	int n = 0;
+	for (const wchar_t c : digits) {
+		if (c < '0' || c > '9') {
+			return -1;
+		}
+		n = n * 10 + (c - '0');
+	}
+	return n;
+}
+
+std::vector<int> MapImageList(std::vector<int> found, int start, int max_gap)
+{
+	std::sort(found.begin(), found.end());
+
+	std::vector<int> numbers;
+	if (found.empty() || found[0] != start) {
+		numbers.emplace_back(start);
+	}
+	for (const int n : found) {
+		if (n < start) {
+			continue;
+		}
+		if (numbers.size()) {
+			const int prev = numbers.back();
+			if (n == prev) {
+				continue;
+			}
+			if (n - prev > max_gap) {
+				// too far away, probably a different sequence
+				break;
+			}
+			numbers.insert(numbers.end(), n - prev - 1, prev);
+		}
+		numbers.emplace_back(n);
+	}
+
+	return numbers;
+}
@@ -0,0 +1,30 @@
+/*
+ * Copyright (C) 2026 v0lt
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+
+#include <string_view>
+#include <vector>
+
+// The number in the file name of an image list, "name0012.png".
+struct ImageListName {
+	size_t name0  = 0; // start of the file name
+	size_t digit0 = 0; // first digit
+	int width     = 0; // count of digits
+	int start     = 0; // the number
+};
+
+// finds the digits just before the extension, ext is the position of its dot,
+// returns false if there are none or more than 9
+bool ParseImageListName(std::wstring_view path, size_t ext, ImageListName& name);
+
+// the number of a file found next to the first one, digits is the part between the prefix and the suffix,
+// -1 unless "%0Nd" with width N gives the same digits
+int ParseImageListNumber(std::wstring_view digits, int width);
+
+// frame -> file number from start, a missing file is held as a duplicate of the previous one,
+// the list ends before a gap larger than max_gap
+std::vector<int> MapImageList(std::vector<int> found, int start, int max_gap);
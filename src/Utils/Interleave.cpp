@@ -0,0 +1,141 @@
+/*
+ * Copyright (C) 2026 v0lt
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// built without the precompiled header, the tests compile this file too
+
+#include "Interleave.h"
+#include <emmintrin.h>
+
+template <typename T, int channels>
+static void interleave_c(T* dst, const T* const* src, int i, int count)
+{
+	for (; i < count; i++) {
+		for (int c = 0; c < channels; c++) {
+			*dst++ = src[c][i];
+		}
+	}
+}
+
+template <typename T>
+static void interleave_c(T* dst, const T* const* src, int channels, int i, int count)
+{
+	dst += i * channels;
+	switch (channels) {
+	case 1: interleave_c<T, 1>(dst, src, i, count); break;
+	case 2: interleave_c<T, 2>(dst, src, i, count); break;
+	case 3: interleave_c<T, 3>(dst, src, i, count); break;
+	case 4: interleave_c<T, 4>(dst, src, i, count); break;
+	case 5: interleave_c<T, 5>(dst, src, i, count); break;
+	case 6: interleave_c<T, 6>(dst, src, i, count); break;
+	case 7: interleave_c<T, 7>(dst, src, i, count); break;
+	case 8: interleave_c<T, 8>(dst, src, i, count); break;
+	}
+}
+
+// 32-bit samples, 2 channels, 4 samples per step
+static int interleave2_32_sse2(uint32_t* dst, const uint32_t* const* src, int count)
+{
+	int i = 0;
+	for (; i + 4 <= count; i += 4) {
+		__m128i a = _mm_loadu_si128((const __m128i*)(src[0] + i));
+		__m128i b = _mm_loadu_si128((const __m128i*)(src[1] + i));
+		_mm_storeu_si128((__m128i*)(dst + i * 2), _mm_unpacklo_epi32(a, b));
+		_mm_storeu_si128((__m128i*)(dst + i * 2 + 4), _mm_unpackhi_epi32(a, b));
+	}
+	return i;
+}
+
+// 32-bit samples, 4 channels, 4x4 transpose
+static int interleave4_32_sse2(uint32_t* dst, const uint32_t* const* src, int count)
+{
+	int i = 0;
+	for (; i + 4 <= count; i += 4) {
+		__m128i a = _mm_loadu_si128((const __m128i*)(src[0] + i));
+		__m128i b = _mm_loadu_si128((const __m128i*)(src[1] + i));
+		__m128i c = _mm_loadu_si128((const __m128i*)(src[2] + i));
+		__m128i d = _mm_loadu_si128((const __m128i*)(src[3] + i));
+		__m128i ab_lo = _mm_unpacklo_epi32(a, b); // a0 b0 a1 b1
+		__m128i ab_hi = _mm_unpackhi_epi32(a, b); // a2 b2 a3 b3
+		__m128i cd_lo = _mm_unpacklo_epi32(c, d);
+		__m128i cd_hi = _mm_unpackhi_epi32(c, d);
+		_mm_storeu_si128((__m128i*)(dst + i * 4), _mm_unpacklo_epi64(ab_lo, cd_lo));
+		_mm_storeu_si128((__m128i*)(dst + i * 4 + 4), _mm_unpackhi_epi64(ab_lo, cd_lo));
+		_mm_storeu_si128((__m128i*)(dst + i * 4 + 8), _mm_unpacklo_epi64(ab_hi, cd_hi));
+		_mm_storeu_si128((__m128i*)(dst + i * 4 + 12), _mm_unpackhi_epi64(ab_hi, cd_hi));
+	}
+	return i;
+}
+
+// 16-bit samples, 2 channels, 8 samples per step
+static int interleave2_16_sse2(uint16_t* dst, const uint16_t* const* src, int count)
+{
+	int i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m128i a = _mm_loadu_si128((const __m128i*)(src[0] + i));
+		__m128i b = _mm_loadu_si128((const __m128i*)(src[1] + i));
+		_mm_storeu_si128((__m128i*)(dst + i * 2), _mm_unpacklo_epi16(a, b));
+		_mm_storeu_si128((__m128i*)(dst + i * 2 + 8), _mm_unpackhi_epi16(a, b));
+	}
+	return i;
+}
+
+// 16-bit samples, 4 channels, 8 samples per step
+static int interleave4_16_sse2(uint16_t* dst, const uint16_t* const* src, int count)
+{
+	int i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m128i a = _mm_loadu_si128((const __m128i*)(src[0] + i));
+		__m128i b = _mm_loadu_si128((const __m128i*)(src[1] + i));
+		__m128i c = _mm_loadu_si128((const __m128i*)(src[2] + i));
+		__m128i d = _mm_loadu_si128((const __m128i*)(src[3] + i));
+		__m128i ab_lo = _mm_unpacklo_epi16(a, b); // a0 b0 .. a3 b3
+		__m128i ab_hi = _mm_unpackhi_epi16(a, b); // a4 b4 .. a7 b7
+		__m128i cd_lo = _mm_unpacklo_epi16(c, d);
+		__m128i cd_hi = _mm_unpackhi_epi16(c, d);
+		_mm_storeu_si128((__m128i*)(dst + i * 4), _mm_unpacklo_epi32(ab_lo, cd_lo));
+		_mm_storeu_si128((__m128i*)(dst + i * 4 + 8), _mm_unpackhi_epi32(ab_lo, cd_lo));
+		_mm_storeu_si128((__m128i*)(dst + i * 4 + 16), _mm_unpacklo_epi32(ab_hi, cd_hi));
+		_mm_storeu_si128((__m128i*)(dst + i * 4 + 24), _mm_unpackhi_epi32(ab_hi, cd_hi));
+	}
+	return i;
+}
+
+bool InterleaveSamples(uint8_t* dst, const uint8_t* const* src, int channels, int count, int sample_size)
+{
+	if (channels < 1 || channels > 8) {
+		return false;
+	}
+
+	if (sample_size == 4) {
+		uint32_t* d = (uint32_t*)dst;
+		const uint32_t* const* s = (const uint32_t* const*)src;
+		int i = 0;
+		if (channels == 2) {
+			i = interleave2_32_sse2(d, s, count);
+		}
+		else if (channels == 4) {
+			i = interleave4_32_sse2(d, s, count);
+		}
+		interleave_c(d, s, channels, i, count);
+		return true;
+	}
+
+	if (sample_size == 2) {
+		uint16_t* d = (uint16_t*)dst;
+		const uint16_t* const* s = (const uint16_t* const*)src;
+		int i = 0;
+		if (channels == 2) {
+			i = interleave2_16_sse2(d, s, count);
+		}
+		else if (channels == 4) {
+			i = interleave4_16_sse2(d, s, count);
+		}
+		interleave_c(d, s, channels, i, count);
+		return true;
+	}
+
+	return false;
+}
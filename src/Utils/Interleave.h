@@ -0,0 +1,14 @@
+/*
+ * Copyright (C) 2026 v0lt
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+
+#include <cstdint>
+
+// Interleaves planar audio samples without format conversion.
+// sample_size is 2 (S16P -> S16) or 4 (FLTP -> FLT, S32P -> S32), channels from 1 to 8.
+// Returns false if the combination is not supported.
+bool InterleaveSamples(uint8_t* dst, const uint8_t* const* src, int channels, int count, int sample_size);
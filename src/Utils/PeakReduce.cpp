@@ -0,0 +1,49 @@
+/*
+ * Copyright (C) 2026 v0lt
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// built without the precompiled header, the tests compile this file too
+
+#include "PeakReduce.h"
+#include <algorithm>
+#include <cfloat>
+#include <emmintrin.h>
+
+void ReducePeakSamples(const float* data, int count, int channels, float* vmin, float* vmax, double* sumsq)
+{
+	const int total = count * channels;
+	int i = 0;
+
+	if (4 % channels == 0) {
+		// every SSE lane holds always the same channel
+		__m128 mn = _mm_set1_ps(FLT_MAX);
+		__m128 mx = _mm_set1_ps(-FLT_MAX);
+		__m128 sq = _mm_setzero_ps();
+		for (; i + 4 <= total; i += 4) {
+			__m128 v = _mm_loadu_ps(data + i);
+			mn = _mm_min_ps(mn, v);
+			mx = _mm_max_ps(mx, v);
+			sq = _mm_add_ps(sq, _mm_mul_ps(v, v));
+		}
+		alignas(16) float lmn[4], lmx[4], lsq[4];
+		_mm_store_ps(lmn, mn);
+		_mm_store_ps(lmx, mx);
+		_mm_store_ps(lsq, sq);
+		for (int l = 0; l < 4; l++) {
+			const int c = l % channels;
+			vmin[c] = std::min(vmin[c], lmn[l]);
+			vmax[c] = std::max(vmax[c], lmx[l]);
+			sumsq[c] += lsq[l];
+		}
+	}
+
+	for (; i < total; i++) {
+		const int c = i % channels;
+		const float v = data[i];
+		vmin[c] = std::min(vmin[c], v);
+		vmax[c] = std::max(vmax[c], v);
+		sumsq[c] += v * v;
+	}
+}
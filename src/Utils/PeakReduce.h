@@ -0,0 +1,11 @@
+/*
+ * Copyright (C) 2026 v0lt
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+
+// Adds count interleaved samples to the min, max and sum of squares of each channel.
+// SSE is used when 4 is a multiple of channels, every lane then holds the same channel.
+void ReducePeakSamples(const float* data, int count, int channels, float* vmin, float* vmax, double* sumsq);
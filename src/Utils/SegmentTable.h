@@ -0,0 +1,26 @@
+/*
+ * Copyright (C) 2026 v0lt
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+// The segment holding pos, starts are the ascending start positions of the sources, the first is 0.
+// pos becomes local to the segment, positions after the end belong to the last segment.
+template <typename T>
+T* FindSegment(const std::vector<T*>& sources, const std::vector<int64_t>& starts, int64_t& pos)
+{
+	if (sources.empty()) {
+		return nullptr;
+	}
+	auto it = std::upper_bound(starts.begin() + 1, starts.end(), pos);
+	const size_t i = it - starts.begin() - 1;
+	pos -= starts[i];
+
+	return sources[i];
+}
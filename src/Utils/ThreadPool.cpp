@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2026 v0lt
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "stdafx.h"
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(int thread_count)
+{
+	if (thread_count <= 0) {
+		thread_count = (int)std::thread::hardware_concurrency();
+		if (thread_count <= 0) {
+			thread_count = 1;
+		}
+	}
+
+	m_threads.reserve(thread_count);
+	for (int i = 0; i < thread_count; i++) {
+		m_threads.emplace_back(&ThreadPool::WorkerThread, this);
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard lock(m_mutex);
+		m_tasks.clear();
+		m_stop = true;
+	}
+	m_cvTask.notify_all();
+
+	for (auto& thread : m_threads) {
+		thread.join();
+	}
+}
+
+void ThreadPool::WorkerThread()
+{
+	while (1) {
+		std::function<void()> task;
+		{
+			std::unique_lock lock(m_mutex);
+			m_cvTask.wait(lock, [this] { return m_stop || !m_tasks.empty(); });
+			if (m_stop) {
+				break;
+			}
+			task = std::move(m_tasks.front());
+			m_tasks.pop_front();
+			m_active++;
+		}
+
+		task();
+
+		{
+			std::lock_guard lock(m_mutex);
+			m_active--;
+			if (!m_active && m_tasks.empty()) {
+				m_cvIdle.notify_all();
+			}
+		}
+	}
+}
+
+void ThreadPool::Push(std::function<void()> task)
+{
+	{
+		std::lock_guard lock(m_mutex);
+		m_tasks.emplace_back(std::move(task));
+	}
+	m_cvTask.notify_one();
+}
+
+void ThreadPool::Clear()
+{
+	std::lock_guard lock(m_mutex);
+	m_tasks.clear();
+	if (!m_active) {
+		m_cvIdle.notify_all();
+	}
+}
+
+void ThreadPool::Wait()
+{
+	std::unique_lock lock(m_mutex);
+	m_cvIdle.wait(lock, [this] { return !m_active && m_tasks.empty(); });
+}
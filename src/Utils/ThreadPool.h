@@ -0,0 +1,40 @@
+/*
+ * Copyright (C) 2026 v0lt
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+#include <functional>
+
+class ThreadPool
+{
+	std::vector<std::thread> m_threads;
+	std::deque<std::function<void()>> m_tasks;
+	std::mutex m_mutex;
+	std::condition_variable m_cvTask;
+	std::condition_variable m_cvIdle;
+	int  m_active = 0;
+	bool m_stop   = false;
+
+	void WorkerThread();
+
+public:
+	// thread_count <= 0 means the number of logical processors
+	ThreadPool(int thread_count = 0);
+	~ThreadPool();
+
+	int GetThreadCount() const { return (int)m_threads.size(); }
+
+	void Push(std::function<void()> task);
+	// removes tasks that have not started yet
+	void Clear();
+	// waits until all queued and running tasks are done
+	void Wait();
+};
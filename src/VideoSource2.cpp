@@ -9,6 +9,8 @@
 
 #include "InputFile2.h"
 #include "VideoSource2.h"
+#include "ImageSequence.h"
+#include "IOBackend.h"
 #include "export.h"
 #include "Helper.h"
 #include "ffmpeg_helper.h"
@@ -22,6 +24,8 @@ extern "C" {
 const int line_align = 16; // should be ok with any usable filter down the pipeline
 extern bool config_force_thread;
 extern float config_cache_size;
+extern int config_segment_idle;
+extern int config_segment_open;
 
 
 VDFFVideoSource::VDFFVideoSource(const VDXInputDriverContext& context)
@@ -88,9 +92,34 @@ void* VDXAPIENTRY VDFFVideoSource::AsInterface(uint32_t iid)
 	if (iid == IVDXStreamSourceV5::kIID)
 		return static_cast<IVDXStreamSourceV5*>(this);
 
+	if (iid == IVDFFPerfCounters::kIID)
+		return static_cast<IVDFFPerfCounters*>(this);
+
 	return vdxunknown<IVDXStreamSource>::AsInterface(iid);
 }
 
+AVRational VDFFVideoSource::get_frame_rate()
+{
+	AVRational r_fr = m_pStream->r_frame_rate;
+	if (r_fr.num <= 0 || r_fr.den <= 0) {
+		return r_fr;
+	}
+
+	if (m_pStream->codecpar->field_order > AV_FIELD_PROGRESSIVE) {
+		// interlaced seems to double r_framerate
+		// example: 00005.MTS
+		// however other samples do not show this
+		// example: amanda_excerpt.m2t
+		// idea of this: r_fr cannot be lower than average
+		AVRational avg_fr = m_pStream->avg_frame_rate;
+		if (int64_t(r_fr.num) * avg_fr.den >= int64_t(avg_fr.num) * r_fr.den * 2) {
+			r_fr.den *= 2;
+		}
+	}
+
+	return r_fr;
+}
+
 int VDFFVideoSource::init_duration(const AVRational fr)
 {
 	AVRational tb = m_pStream->time_base;
@@ -104,15 +133,25 @@ int VDFFVideoSource::init_duration(const AVRational fr)
 
 	}
 	else {
-		int64_t duration = m_pStream->duration;
-
-		if (m_pStream->duration == AV_NOPTS_VALUE) {
-			if (m_pFormatCtx->duration != AV_NOPTS_VALUE) {
+		// end of the last packet found by the tail scan, a timestamp rather than a duration
+		const int64_t end_pts = m_pSource->get_end_pts(m_streamIndex);
+		const int64_t first_pts = (m_pStream->start_time != AV_NOPTS_VALUE) ? m_pStream->start_time : 0;
+		const bool from_tail = (end_pts != AV_NOPTS_VALUE && end_pts > first_pts);
+
+		int64_t duration = AV_NOPTS_VALUE;
+		if (!from_tail) {
+			duration = m_pStream->duration;
+			if (duration == AV_NOPTS_VALUE && m_pFormatCtx->duration != AV_NOPTS_VALUE) {
 				duration = av_rescale_q_rnd(m_pFormatCtx->duration, av_make_q(1, AV_TIME_BASE), m_pStream->time_base, AV_ROUND_NEAR_INF);
 			}
 		}
 
-		if (duration != AV_NOPTS_VALUE) {
+		if (from_tail) {
+			// relative to the first packet also for mpegts
+			const int rndd = m_frame_ts.num / 2;
+			m_sample_count = (int)(((end_pts - first_pts) * m_frame_ts.den + rndd) / m_frame_ts.num);
+		}
+		else if (duration != AV_NOPTS_VALUE) {
 			//! stream duration really means last timestamp
 			// found on "10 bit.mp4"
 			// also works with mkv (derived from file duration)
@@ -209,6 +248,7 @@ int VDFFVideoSource::initStream(VDFFInputFile* pSource, const int streamIndex)
 		mContext.mpCallbacks->SetError("FFMPEG: Unsupported video codec (%s)", buf);
 		return -1;
 	}
+	m_pDecoder = pDecoder;
 	m_pCodecCtx = avcodec_alloc_context3(pDecoder);
 	if (!m_pCodecCtx) {
 		return -1;
@@ -219,23 +259,11 @@ int VDFFVideoSource::initStream(VDFFInputFile* pSource, const int streamIndex)
 	}
 	avcodec_parameters_to_context(m_pCodecCtx, m_pStream->codecpar);
 
-	AVRational r_fr = m_pStream->r_frame_rate;
+	const AVRational r_fr = get_frame_rate();
 	if (r_fr.num <= 0 || r_fr.den <= 0) {
 		mContext.mpCallbacks->SetError("FFMPEG: Corrupted video frame rate value (%d/%d)", r_fr.num, r_fr.den);
 		return -1;
 	}
-
-	if (m_pStream->codecpar->field_order > AV_FIELD_PROGRESSIVE) {
-		// interlaced seems to double r_framerate
-		// example: 00005.MTS
-		// however other samples do not show this
-		// example: amanda_excerpt.m2t
-		// idea of this: r_fr cannot be lower than average
-		AVRational avg_fr = m_pStream->avg_frame_rate;
-		if (int64_t(r_fr.num) * avg_fr.den >= int64_t(avg_fr.num) * r_fr.den * 2) {
-			r_fr.den *= 2;
-		}
-	}
 	int sample_count_error = init_duration(r_fr);
 	if (sample_count_error == -1) {
 		return -1;
@@ -415,6 +443,13 @@ int VDFFVideoSource::initStream(VDFFInputFile* pSource, const int streamIndex)
 	if (buffer_reserve < pSource->cfg_frame_buffers) {
 		buffer_reserve = pSource->cfg_frame_buffers;
 	}
+	if (pSource->image_sequence) {
+		// room for the current frame and the frames decoded ahead in either direction
+		int n = pSource->image_sequence->get_prefetch_count() * 2 + 1;
+		if (buffer_reserve < n) {
+			buffer_reserve = n;
+		}
+	}
 	if (buffer_reserve > m_sample_count) {
 		buffer_reserve = m_sample_count;
 	}
@@ -462,24 +497,20 @@ int VDFFVideoSource::initStream(VDFFInputFile* pSource, const int streamIndex)
 		max_virtual = max2;
 	}
 
+	// segments are opened in any order, only those holding their cache count
 	uint64_t mem_other = 0;
 	if (m_pSource->head_segment) {
-		VDFFInputFile* f1 = m_pSource->head_segment;
-		while (1) {
-			if (!f1->video_source) {
-				break;
-			}
-			mem_other += uint64_t(frame_size) * f1->video_source->buffer_reserve;
-			f1 = f1->next_segment;
-			if (!f1) {
-				break;
+		for (VDFFInputFile* f1 = m_pSource->head_segment; f1 && f1->video_source; f1 = f1->next_segment) {
+			VDFFVideoSource* v1 = f1->video_source;
+			if (v1 != this && !v1->m_deferred && !v1->m_released) {
+				mem_other += uint64_t(v1->frame_size) * v1->buffer_reserve;
 			}
 		}
 	}
 
 	uint64_t mem_size = uint64_t(frame_size) * buffer_reserve;
 	if (mem_size + mem_other > max_virtual || pSource->cfg_disable_cache) {
-		buffer_reserve = int((max_virtual - mem_other) / frame_size);
+		buffer_reserve = max_virtual > mem_other ? int((max_virtual - mem_other) / frame_size) : 0;
 		if (buffer_reserve < pSource->cfg_frame_buffers || pSource->cfg_disable_cache) {
 			buffer_reserve = pSource->cfg_frame_buffers;
 		}
@@ -572,14 +603,124 @@ int VDFFVideoSource::initStream(VDFFInputFile* pSource, const int streamIndex)
 		init_format();
 	}
 
+	if (pSource->head_segment) {
+		// appended segments hold no decoder until they are read
+		release();
+	}
+
 	return 0;
 }
 
+int VDFFVideoSource::initSegment(VDFFInputFile* pSource, const int streamIndex)
+{
+	m_pSource = pSource;
+	m_streamIndex = streamIndex;
+
+	m_pFormatCtx = pSource->getContext();
+	m_pStream = m_pFormatCtx->streams[m_streamIndex];
+
+	const AVRational r_fr = get_frame_rate();
+	if (r_fr.num <= 0 || r_fr.den <= 0) {
+		mContext.mpCallbacks->SetError("FFMPEG: Corrupted video frame rate value (%d/%d)", r_fr.num, r_fr.den);
+		return -1;
+	}
+	int sample_count_error = init_duration(r_fr);
+	if (sample_count_error == -1) {
+		return -1;
+	}
+
+	// the same choice as initStream makes with the index loaded by open_segment,
+	// or with the count from the header
+	int64_t nb_frames = avformat_index_get_entries_count(m_pStream);
+	if (nb_frames <= 2) {
+		nb_frames = m_pStream->nb_frames;
+	}
+	if (nb_frames > 0 && !pSource->is_image && m_pFormatCtx->iformat != av_find_input_format("avi")) {
+		if (abs(nb_frames - m_sample_count) <= sample_count_error) {
+			m_sample_count = (int)nb_frames;
+		}
+		else if (m_pStream->avg_frame_rate.num != 0) {
+			sample_count_error = init_duration(m_pStream->avg_frame_rate);
+			if (abs(nb_frames - m_sample_count) <= sample_count_error) {
+				m_sample_count = (int)nb_frames;
+			}
+			else {
+				init_duration(r_fr);
+			}
+		}
+	}
+
+	m_streamInfo.mInfo.mSampleCount = m_sample_count;
+	m_released = true;
+	m_deferred = true;
+
+	return 0;
+}
+
+bool VDFFVideoSource::init_deferred()
+{
+	if (!m_deferred) {
+		return true;
+	}
+	std::lock_guard lock(m_initMutex);
+	if (!m_deferred) {
+		return true;
+	}
+
+	// left by an attempt that failed, the pre-warming thread may try first
+	av_frame_free(&m_pFrame);
+	avcodec_free_context(&m_pCodecCtx);
+	if (mem) {
+		CloseHandle(mem);
+		mem = nullptr;
+	}
+
+	const int count = m_sample_count;
+	m_released = false;
+	if (initStream(m_pSource, m_streamIndex) < 0) {
+		m_sample_count = count;
+		m_released = true;
+		return false;
+	}
+	fit_sample_count(count);
+
+	VDFFVideoSource* head = m_pSource->head_segment->video_source;
+	SetTargetFormat(head->m_convertInfo.req_format, head->m_convertInfo.req_dib, head);
+	setCopyMode(head->m_copy_mode);
+	setDecodeMode(head->m_decode_mode);
+	setCacheMode(!head->m_small_cache_mode);
+
+	m_deferred = false;
+	DLog(L"VDFFVideoSource: opened segment {}", m_pSource->m_path);
+
+	return true;
+}
+
+void VDFFVideoSource::fit_sample_count(const int count)
+{
+	if (m_sample_count == count) {
+		return;
+	}
+	DLog(L"VDFFVideoSource: segment has {} frames, {} expected", m_sample_count, count);
+
+	// the segment is released, no frame is cached
+	m_sample_count = count;
+	frame_array.resize(m_sample_count);
+	frame_type.resize(m_sample_count, ' ');
+	m_streamInfo.mInfo.mSampleCount = m_sample_count;
+
+	if (trust_index && index_count() < m_sample_count) {
+		// frames past the index are found by their timestamps
+		trust_index  = false;
+		sparse_index = index_count() > 1;
+	}
+}
+
 bool VDFFVideoSource::possible_delay()
 {
 	if (is_intra()) return false;
 
-	AVCodecID codec_id = m_pStream->codecpar->codec_id;
+	AVCodecID codec_id = m_pCodecCtx->codec_id;
 	const AVCodecDescriptor* desc = avcodec_descriptor_get(codec_id);
 	if (desc && (desc->props & AV_CODEC_PROP_REORDER)) {
 		return true;
@@ -596,7 +737,7 @@ bool VDFFVideoSource::is_intra()
 		return true;
 	}
 
-	AVCodecID codec_id = m_pStream->codecpar->codec_id;
+	AVCodecID codec_id = m_pCodecCtx->codec_id;
 	// various intra codecs
 	switch (codec_id) {
 	case AV_CODEC_ID_CLLC:
@@ -673,9 +814,15 @@ void VDXAPIENTRY VDFFVideoSource::ApplyStreamMode(uint32 flags)
 	if (flags & kStreamModeDirectCopy) copy_mode = true;
 	if (flags & kStreamModeUncompress) decode_mode = true;
 	if (flags & kStreamModePlayForward) cache_mode = false;
-	setCopyMode(copy_mode);
-	setDecodeMode(decode_mode);
-	setCacheMode(cache_mode);
+	{
+		// a segment that is not opened takes the mode of the head in init_deferred
+		std::lock_guard lock(m_initMutex);
+		if (!m_deferred) {
+			setCopyMode(copy_mode);
+			setDecodeMode(decode_mode);
+			setCacheMode(cache_mode);
+		}
+	}
 
 	if (m_pSource->next_segment) m_pSource->next_segment->video_source->ApplyStreamMode(flags);
 }
@@ -683,6 +830,10 @@ void VDXAPIENTRY VDFFVideoSource::ApplyStreamMode(uint32 flags)
 bool VDXAPIENTRY VDFFVideoSource::QueryStreamMode(uint32 flags)
 {
 	if (flags == kStreamModeDirectCopy) {
+		// the direct format of every segment is needed
+		if (!init_deferred()) {
+			return false;
+		}
 		if (m_direct_format.empty()) {
 			return false;
 		}
@@ -818,9 +969,8 @@ bool VDFFVideoSource::CreateVideoDecoderModel(IVDXVideoDecoderModel** ppModel)
 void VDFFVideoSource::GetSampleInfo(sint64 sample, VDXVideoFrameInfo& frameInfo)
 {
 	if (sample >= m_sample_count) {
-		if (m_pSource->next_segment) {
-			auto v1 = m_pSource->next_segment->video_source;
-			v1->GetSampleInfo(sample - m_sample_count, frameInfo);
+		if (VDFFVideoSource* v1 = find_segment(sample)) {
+			v1->GetSampleInfo(sample, frameInfo);
 		}
 		return;
 	}
@@ -838,9 +988,8 @@ void VDFFVideoSource::GetSampleInfo(sint64 sample, VDXVideoFrameInfo& frameInfo)
 bool VDFFVideoSource::IsKey(int64_t sample)
 {
 	if (sample >= m_sample_count) {
-		if (m_pSource->next_segment) {
-			auto v1 = m_pSource->next_segment->video_source;
-			return v1->IsKey(sample - m_sample_count);
+		if (VDFFVideoSource* v1 = find_segment(sample)) {
+			return v1->IsKey(sample);
 		}
 		return false;
 	}
@@ -848,7 +997,7 @@ bool VDFFVideoSource::IsKey(int64_t sample)
 	if (is_image_list) return true;
 
 	if (trust_index) {
-		return (avformat_index_get_entry(m_pStream, (int)sample)->flags & AVINDEX_KEYFRAME) != 0;
+		return index_key((int)sample);
 	}
 	if (sparse_index) {
 		int64_t pos;
@@ -910,14 +1059,15 @@ const void* VDFFVideoSource::DecodeFrame(const void* inputBuffer, uint32_t data_
 	m_pixmap_info.frame_num = -1;
 
 	if (targetFrame >= m_sample_count) {
-		VDFFVideoSource* v1 = nullptr;
-		if (m_pSource->next_segment) v1 = m_pSource->next_segment->video_source;
+		VDFFVideoSource* v1 = find_segment(targetFrame);
 		if (!v1) return 0;
-		return v1->DecodeFrame(inputBuffer, data_len, is_preroll, streamFrame, targetFrame - m_sample_count);
+		return v1->DecodeFrame(inputBuffer, data_len, is_preroll, streamFrame, targetFrame);
 	}
 
 	if (is_preroll) return 0;
 
+	std::lock_guard lock(m_mutex);
+
 	if (m_convertInfo.out_garbage) {
 		mContext.mpCallbacks->SetError("Segment has incompatible format: try changing decode format to RGBA");
 		return 0;
@@ -939,6 +1089,8 @@ const void* VDFFVideoSource::DecodeFrame(const void* inputBuffer, uint32_t data_
 	open_read(page);
 	uint8_t* src = page->pic_data;
 
+	m_perf.delivered++;
+
 	if (m_convertInfo.direct_copy) {
 		set_pixmap_layout(src);
 		return src;
@@ -964,7 +1116,10 @@ const void* VDFFVideoSource::DecodeFrame(const void* inputBuffer, uint32_t data_
 		pic2.linesize[1] = int(m_pixmap.pitch2);
 		pic2.linesize[2] = int(m_pixmap.pitch3);
 		pic2.linesize[3] = int(m_pixmap.pitch4);
-		sws_scale(m_pSwsCtx, pic.data, pic.linesize, 0, h, pic2.data, pic2.linesize);
+		{
+			PerfTimer timer(m_perf.convert_time);
+			sws_scale(m_pSwsCtx, pic.data, pic.linesize, 0, h, pic2.data, pic2.linesize);
+		}
 		return m_pixmap_data;
 	}
 }
@@ -980,8 +1135,8 @@ bool VDFFVideoSource::IsFrameBufferValid()
 	if (m_pixmap_frame == -1) return false;
 
 	if (m_pixmap_frame >= m_sample_count) {
-		VDFFVideoSource* v1 = nullptr;
-		if (m_pSource->next_segment) v1 = m_pSource->next_segment->video_source;
+		int64_t pos = m_pixmap_frame;
+		VDFFVideoSource* v1 = find_segment(pos);
 		if (!v1) return 0;
 		return v1->IsFrameBufferValid();
 	}
@@ -993,8 +1148,8 @@ bool VDFFVideoSource::IsFrameBufferValid()
 const VDXPixmap& VDFFVideoSource::GetFrameBuffer()
 {
 	if (m_pixmap_frame >= m_sample_count) {
-		if (m_pSource->next_segment) {
-			auto v1 = m_pSource->next_segment->video_source;
+		int64_t pos = m_pixmap_frame;
+		if (VDFFVideoSource* v1 = find_segment(pos)) {
 			return v1->GetFrameBuffer();
 		}
 	}
@@ -1005,8 +1160,8 @@ const VDXPixmap& VDFFVideoSource::GetFrameBuffer()
 const FilterModPixmapInfo& VDFFVideoSource::GetFrameBufferInfo()
 {
 	if (m_pixmap_frame >= m_sample_count) {
-		if (m_pSource->next_segment) {
-			auto v1 = m_pSource->next_segment->video_source;
+		int64_t pos = m_pixmap_frame;
+		if (VDFFVideoSource* v1 = find_segment(pos)) {
 			return v1->GetFrameBufferInfo();
 		}
 	}
@@ -1024,10 +1179,8 @@ const void* VDFFVideoSource::GetFrameBufferBase()
 	}
 
 	if (m_pixmap_frame >= m_sample_count) {
-		VDFFVideoSource* v1 = nullptr;
-		if (m_pSource->next_segment) {
-			v1 = m_pSource->next_segment->video_source;
-		}
+		int64_t pos = m_pixmap_frame;
+		VDFFVideoSource* v1 = find_segment(pos);
 		if (!v1) {
 			return nullptr;
 		}
@@ -1048,6 +1201,9 @@ bool VDFFVideoSource::SetTargetFormat(int format, bool useDIBAlignment)
 		f1 = f1->next_segment;
 		if (!f1) break;
 		if (f1->video_source) {
+			// a segment that is not opened takes the format of the head in init_deferred
+			std::lock_guard lock(f1->video_source->m_initMutex);
+			if (f1->video_source->m_deferred) continue;
 			bool r1 = f1->video_source->SetTargetFormat(opt_format, useDIBAlignment, this);
 			if (!r1 && opt_format != 0) f1->video_source->SetTargetFormat(nsVDXPixmap::kPixFormat_Null, useDIBAlignment, this);
 		}
@@ -1785,9 +1941,9 @@ int64_t VDFFVideoSource::frame_to_pts_next(const int64_t start)
 {
 	if (trust_index) {
 		int next_key = -1;
-		const int nb_index_entries = avformat_index_get_entries_count(m_pStream);
+		const int nb_index_entries = index_count();
 		for (int i = (int)start; i < nb_index_entries; i++) {
-			if (avformat_index_get_entry(m_pStream, i)->flags & AVINDEX_KEYFRAME) {
+			if (index_key(i)) {
 				next_key = i;
 				break;
 			}
@@ -1795,7 +1951,7 @@ int64_t VDFFVideoSource::frame_to_pts_next(const int64_t start)
 		if (next_key == -1) {
 			return -1;
 		}
-		int64_t pos = avformat_index_get_entry(m_pStream, next_key)->timestamp;
+		int64_t pos = index_timestamp(next_key);
 		return pos;
 	}
 	else {
@@ -1812,11 +1968,11 @@ int VDFFVideoSource::calc_sparse_key(const int64_t sample, int64_t& pos)
 	// half-frame bias helps with some rounding noise
 	// works with 2017-04-07 08-53-48.flv
 	int64_t pos1 = (sample * m_frame_ts.num + m_frame_ts.num / 2) / m_frame_ts.den;
-	int x = av_index_search_timestamp(m_pStream, pos1, AVSEEK_FLAG_BACKWARD);
+	int x = index_search(pos1);
 	if (x == -1) {
 		return -1;
 	}
-	pos = avformat_index_get_entry(m_pStream, x)->timestamp;
+	pos = index_timestamp(x);
 	const int rndd = m_frame_ts.num / 2;
 	int frame = int((pos * m_frame_ts.den + rndd) / m_frame_ts.num);
 	return frame;
@@ -1835,7 +1991,7 @@ int VDFFVideoSource::calc_seek(const int jump, int64_t& pos)
 	if (trust_index && jump > next_frame) {
 		int next_key = -1;
 		for (int i = jump; i > next_frame; i--) {
-			if (avformat_index_get_entry(m_pStream, i)->flags & AVINDEX_KEYFRAME) {
+			if (index_key(i)) {
 				next_key = i;
 				break;
 			}
@@ -1843,7 +1999,7 @@ int VDFFVideoSource::calc_seek(const int jump, int64_t& pos)
 
 		if (next_key != -1 && (next_frame == -1 || next_key > next_frame + fw_seek_threshold)) {
 			// required to seek forward
-			pos = avformat_index_get_entry(m_pStream, next_key)->timestamp;
+			pos = index_timestamp(next_key);
 			return next_key;
 		}
 	}
@@ -1852,12 +2008,12 @@ int VDFFVideoSource::calc_seek(const int jump, int64_t& pos)
 		// required to seek backward
 		int prev_key = 0;
 		for (int i = jump; i >= 0; i--) {
-			if (avformat_index_get_entry(m_pStream, i)->flags & AVINDEX_KEYFRAME) {
+			if (index_key(i)) {
 				prev_key = i;
 				break;
 			}
 		}
-		pos = avformat_index_get_entry(m_pStream, prev_key)->timestamp;
+		pos = index_timestamp(prev_key);
 		return prev_key;
 	}
 
@@ -1938,7 +2094,7 @@ int VDFFVideoSource::calc_prefetch(const int jump)
 	int prev_key = 0;
 	if (trust_index) {
 		for (int i = x; i >= 0; i--) {
-			if (avformat_index_get_entry(m_pStream, i)->flags & AVINDEX_KEYFRAME) {
+			if (index_key(i)) {
 				prev_key = i;
 				break;
 			}
@@ -1957,13 +2113,18 @@ int VDFFVideoSource::calc_prefetch(const int jump)
 
 bool VDFFVideoSource::Read(sint64 start, uint32 lCount, void* lpBuffer, uint32 cbBuffer, uint32* lBytesRead, uint32* lSamplesRead)
 {
+	if (m_pSource->check_growth(m_growth)) {
+		grow();
+	}
+
 	if (start >= m_sample_count) {
-		VDFFVideoSource* v1 = nullptr;
-		if (m_pSource->next_segment) {
-			v1 = m_pSource->next_segment->video_source;
+		int64_t pos = start;
+		if (VDFFVideoSource* v1 = find_segment(pos)) {
+			return v1->Read(pos, lCount, lpBuffer, cbBuffer, lBytesRead, lSamplesRead);
 		}
-		if (v1) {
-			return v1->Read(start - m_sample_count, lCount, lpBuffer, cbBuffer, lBytesRead, lSamplesRead);
+		if (start > m_sample_count) {
+			// the segment could not be opened, the error is set
+			return false;
 		}
 	}
 
@@ -1973,6 +2134,19 @@ bool VDFFVideoSource::Read(sint64 start, uint32 lCount, void* lpBuffer, uint32 c
 		return true;
 	}
 
+	release_idle_segments();
+	prewarm_next(start);
+
+	std::lock_guard lock(m_mutex);
+	if (!wake()) {
+		return false;
+	}
+
+	return read_sample(start, lpBuffer, cbBuffer, lBytesRead, lSamplesRead, false);
+}
+
+bool VDFFVideoSource::read_sample(int64_t start, void* lpBuffer, uint32_t cbBuffer, uint32_t* lBytesRead, uint32_t* lSamplesRead, bool prewarm)
+{
 	*lBytesRead = 0;
 	*lSamplesRead = 1;
 
@@ -2017,10 +2191,23 @@ bool VDFFVideoSource::Read(sint64 start, uint32 lCount, void* lpBuffer, uint32 c
 	if (m_pSource->head_segment) {
 		head = m_pSource->head_segment->video_source;
 	}
-	if (head->required_count) {
+	if (head->required_count && !prewarm) {
 		head->required_count--;
 	}
 
+	if (!m_copy_mode) {
+		if (frame_array[(size_t)start]) {
+			m_perf.cache_hits++;
+		} else {
+			m_perf.cache_misses++;
+		}
+	}
+
+	if (m_pSource->image_sequence && !m_copy_mode) {
+		PerfTimer timer(m_perf.decode_time);
+		return read_image_sequence((int)start);
+	}
+
 	int jump = (int)start;
 	if (!m_copy_mode && frame_array[jump]) {
 		jump = calc_prefetch(jump);
@@ -2044,6 +2231,7 @@ bool VDFFVideoSource::Read(sint64 start, uint32 lCount, void* lpBuffer, uint32 c
 			enable_prefetch = true;
 		}
 
+		m_perf.seeks++;
 		avcodec_flush_buffers(m_pCodecCtx);
 		// don't use AVSEEK_FLAG_BACKWARD for MP4
 		// Comment from LAV Filters source code: "MP4 index timestamps are DTS, seeking expects PTS however..."
@@ -2061,7 +2249,12 @@ bool VDFFVideoSource::Read(sint64 start, uint32 lCount, void* lpBuffer, uint32 c
 	}
 
 	while (1) {
-		if (!read_frame(start)) {
+		bool ok;
+		{
+			PerfTimer timer(m_perf.decode_time);
+			ok = read_frame(start);
+		}
+		if (!ok) {
 			bool fail = true;
 			if (next_frame > 0) {
 				// end of stream, fill with dups
@@ -2108,6 +2301,113 @@ bool VDFFVideoSource::Read(sint64 start, uint32 lCount, void* lpBuffer, uint32 c
 	return false;
 }
 
+bool VDFFVideoSource::read_image_sequence(const int frame)
+{
+	VDFFImageSequence* seq = m_pSource->image_sequence;
+
+	// prefetch in the playback direction
+	const int dir = (last_request != -1 && frame < last_request) ? -1 : 1;
+	last_request = frame;
+
+	int buffer_max = m_small_cache_mode ? small_buffer_count : (int)buffer.size();
+	int prefetch = std::min(seq->get_prefetch_count(), buffer_max - 1);
+	if (prefetch < 0) {
+		prefetch = 0;
+	}
+
+	int first = frame;
+	int last = frame;
+	if (dir > 0) {
+		last = std::min(frame + prefetch, m_sample_count - 1);
+	} else {
+		first = std::max(frame - prefetch, 0);
+	}
+	// missing files are shown as the previous existing one
+	seq->retain(seq->source_frame(first), last);
+
+	for (int i = 0; i <= prefetch; i++) {
+		const int f = frame + dir * i;
+		if (f < first || f > last) {
+			break;
+		}
+		if (!frame_array[f]) {
+			const int src = seq->source_frame(f);
+			if (!frame_array[src]) {
+				seq->request(src);
+			}
+		}
+	}
+
+	// keep the I/O busy further ahead than the decoders
+	const int read_ahead = seq->get_read_ahead_count();
+	if (read_ahead) {
+		int io_first = frame;
+		int io_last = frame;
+		if (dir > 0) {
+			io_last = std::min(frame + read_ahead, m_sample_count - 1);
+		} else {
+			io_first = std::max(frame - read_ahead, 0);
+		}
+		seq->retain_files(seq->source_frame(io_first), io_last);
+
+		for (int f = (dir > 0) ? io_first : io_last; f >= io_first && f <= io_last; f += dir) {
+			const int src = seq->source_frame(f);
+			if (!frame_array[src]) {
+				seq->read_file(src);
+			}
+		}
+	}
+
+	// move decoded frames to the cache, the requested frame is waited for
+	for (int i = 0; i <= prefetch; i++) {
+		const int f = frame + dir * i;
+		if (f < first || f > last) {
+			break;
+		}
+		if (frame_array[f]) {
+			continue;
+		}
+		const int src = seq->source_frame(f);
+		if (!frame_array[src]) {
+			AVFrame* pic = seq->take(src, f == frame);
+			if (!pic) {
+				continue;
+			}
+
+			// make room without touching the frames in the prefetch window
+			while (used_frames >= buffer_max) {
+				BufferPage* p = remove_page(first, true, false);
+				if (!p) {
+					p = remove_page(last, false, true);
+				}
+				if (!p) {
+					break;
+				}
+			}
+
+			av_frame_unref(m_pFrame);
+			av_frame_move_ref(m_pFrame, pic);
+			av_frame_free(&pic);
+			decoded_count++;
+			store_frame(src);
+			av_frame_unref(m_pFrame);
+		}
+		if (src != f && frame_array[src]) {
+			copy_page(f, f, frame_array[src]);
+		}
+	}
+
+	// the demuxer position is no longer known
+	next_frame = -1;
+
+	if (!frame_array[frame]) {
+		mContext.mpCallbacks->SetError("FFMPEG: Unable to decode image %d.", frame);
+		return false;
+	}
+
+	return true;
+}
+
 bool VDFFVideoSource::read_frame(const int64_t desired_frame, bool init)
 {
 	std::unique_ptr<AVPacket, std::function<void(AVPacket*)>> pkt{ av_packet_alloc(), [](AVPacket* p) { av_packet_free(&p); } };
@@ -2121,6 +2421,7 @@ bool VDFFVideoSource::read_frame(const int64_t desired_frame, bool init)
 			}
 			bool done = false;
 			if (pkt->stream_index == m_streamIndex) {
+				m_perf.bytes_read += pkt->size;
 				int pos = handle_frame_num(pkt->pts, pkt->dts);
 				if (pos == -1 || pos > desired_frame) {
 					av_packet_unref(pkt.get());
@@ -2164,6 +2465,7 @@ bool VDFFVideoSource::read_frame(const int64_t desired_frame, bool init)
 		}
 		else {
 			if (pkt->stream_index == m_streamIndex) {
+				m_perf.bytes_read += pkt->size;
 				ret = avcodec_send_packet(m_pCodecCtx, pkt.get());
 				while (ret >= 0) {
 					ret = avcodec_receive_frame(m_pCodecCtx, m_pFrame);
@@ -2179,6 +2481,9 @@ bool VDFFVideoSource::read_frame(const int64_t desired_frame, bool init)
 					int pos = handle_frame();
 					av_frame_unref(m_pFrame);
 					done_frames++;
+					if (pos < desired_frame) {
+						m_perf.preroll_wasted++;
+					}
 					if (m_copy_mode && pos == desired_frame) {
 						av_packet_unref(copy_pkt);
 						av_packet_ref(copy_pkt, pkt.get());
@@ -2261,6 +2566,13 @@ int VDFFVideoSource::handle_frame()
 
 	next_frame = pos + 1;
 
+	store_frame(pos);
+
+	return pos;
+}
+
+void VDFFVideoSource::store_frame(const int pos)
+{
 	if (!frame_array[pos]) {
 		alloc_page(pos);
 		frame_type[pos] = av_get_picture_type_char(m_pFrame->pict_type);
@@ -2275,6 +2587,7 @@ int VDFFVideoSource::handle_frame()
 			page->error = BufferPage::err_badformat;
 		}
 		else {
+			PerfTimer timer(m_perf.copy_time);
 			uint8_t* dst = page->pic_data;
 			if (m_convertInfo.ext_format == nsVDXPixmap::kPixFormat_YUV422_V210) {
 				memcpy(dst, m_pFrame->data[0], m_pFrame->linesize[0] * m_pFrame->height);
@@ -2287,8 +2600,6 @@ int VDFFVideoSource::handle_frame()
 			}
 		}
 	}
-
-	return pos;
 }
 
 bool VDFFVideoSource::check_frame_format()
@@ -2299,6 +2610,279 @@ bool VDFFVideoSource::check_frame_format()
 	return true;
 }
 
+VDFFVideoSource* VDFFVideoSource::find_segment(int64_t& pos)
+{
+	pos -= m_sample_count;
+	return m_pSource->find_video_segment(pos);
+}
+
+void VDFFVideoSource::release()
+{
+	std::lock_guard lock(m_mutex);
+	if (m_released || is_image_list) {
+		return;
+	}
+	m_released = true;
+	m_prewarmed = false;
+
+	free_buffers();
+	for (auto& page : buffer) {
+		dealloc_page(&page);
+	}
+	av_packet_unref(copy_pkt);
+	if (mem) {
+		CloseHandle(mem);
+		mem = nullptr;
+		m_releasedMem = true;
+	}
+
+	// replace the decoder with an unopened one that keeps the parameters found while decoding
+	AVCodecContext* avctx = avcodec_alloc_context3(m_pDecoder);
+	AVCodecParameters* par = avcodec_parameters_alloc();
+	if (avctx && par && avcodec_parameters_from_context(par, m_pCodecCtx) >= 0 && avcodec_parameters_to_context(avctx, par) >= 0) {
+		avctx->flags2 = m_pCodecCtx->flags2;
+		avctx->strict_std_compliance = m_pCodecCtx->strict_std_compliance;
+		avctx->thread_count = m_pCodecCtx->thread_count;
+		avctx->thread_type = m_pCodecCtx->thread_type;
+		avctx->has_b_frames = m_pCodecCtx->has_b_frames;
+		std::swap(avctx, m_pCodecCtx);
+	} else {
+		avcodec_flush_buffers(m_pCodecCtx);
+	}
+	avcodec_parameters_free(&par);
+	avcodec_free_context(&avctx);
+
+	if (m_pSource->head_segment) {
+		// the demuxer holds the whole index and the I/O buffers, keep only the index entries
+		if (m_index.empty()) {
+			const int count = avformat_index_get_entries_count(m_pStream);
+			m_index.resize(count);
+			for (int i = 0; i < count; i++) {
+				const AVIndexEntry* ie = avformat_index_get_entry(m_pStream, i);
+				m_index[i] = { ie->timestamp, ie->flags };
+			}
+		}
+		m_pFormatCtx = nullptr;
+		m_pStream = nullptr;
+		m_pSource->close_demuxer();
+	}
+	// the demuxer position is no longer known, decoding begins from a key frame
+	next_frame = -1;
+	last_seek_frame = -1;
+}
+
+bool VDFFVideoSource::wake()
+{
+	if (!m_released) {
+		return true;
+	}
+
+	// on failure the segment stays released, so the next Read tries again and reports the error
+	if (!reopen_demuxer()) {
+		return false;
+	}
+	if (m_releasedMem) {
+		uint64_t mem_size = uint64_t(frame_size) * buffer_reserve;
+		mem_size = (mem_size + 0xFFFF) & ~0xFFFF;
+		mem = CreateFileMappingW(INVALID_HANDLE_VALUE, 0, PAGE_READWRITE, mem_size >> 32, (DWORD)mem_size, 0);
+		if (!mem) {
+			mContext.mpCallbacks->SetErrorOutOfMemory();
+			return false;
+		}
+		m_releasedMem = false;
+	}
+
+	if (!avcodec_is_open(m_pCodecCtx)) {
+		int ret = avcodec_open2(m_pCodecCtx, m_pDecoder, nullptr);
+		if (ret < 0) {
+			std::string errstr = AVError2Str(ret);
+			mContext.mpCallbacks->SetError("FFMPEG video decoder error: %s.", errstr.c_str());
+			return false;
+		}
+	}
+	m_released = false;
+
+	return true;
+}
+
+bool VDFFVideoSource::reopen_demuxer()
+{
+	if (m_pFormatCtx) {
+		return true;
+	}
+	AVFormatContext* fmt = m_pSource->open_demuxer();
+	if (!fmt) {
+		return false;
+	}
+	if (m_streamIndex >= (int)fmt->nb_streams || fmt->streams[m_streamIndex]->codecpar->codec_id != m_pCodecCtx->codec_id) {
+		mContext.mpCallbacks->SetError("FFMPEG: Segment has changed since it was opened.");
+		return false;
+	}
+	m_pFormatCtx = fmt;
+	m_pStream = fmt->streams[m_streamIndex];
+
+	return true;
+}
+
+bool VDFFVideoSource::open_demuxer()
+{
+	std::lock_guard lock(m_mutex);
+	return reopen_demuxer();
+}
+
+int VDFFVideoSource::index_count()
+{
+	return m_index.empty() && m_pStream ? avformat_index_get_entries_count(m_pStream) : (int)m_index.size();
+}
+
+int64_t VDFFVideoSource::index_timestamp(const int i)
+{
+	return m_index.empty() ? avformat_index_get_entry(m_pStream, i)->timestamp : m_index[i].timestamp;
+}
+
+bool VDFFVideoSource::index_key(const int i)
+{
+	const int flags = m_index.empty() ? avformat_index_get_entry(m_pStream, i)->flags : m_index[i].flags;
+	return (flags & AVINDEX_KEYFRAME) != 0;
+}
+
+int VDFFVideoSource::index_search(const int64_t ts)
+{
+	if (m_index.empty()) {
+		return m_pStream ? av_index_search_timestamp(m_pStream, ts, AVSEEK_FLAG_BACKWARD) : -1;
+	}
+	// the last key frame at or before ts
+	auto it = std::upper_bound(m_index.begin(), m_index.end(), ts, [](int64_t t, const IndexEntry& e) { return t < e.timestamp; });
+	int x = int(it - m_index.begin()) - 1;
+	while (x >= 0 && !(m_index[x].flags & AVINDEX_KEYFRAME)) {
+		x--;
+	}
+	return x;
+}
+
+void VDFFVideoSource::release_idle_segments()
+{
+	const uint64_t now = GetTickCount64();
+	m_lastAccess = now;
+
+	VDFFInputFile* f = m_pSource->head_segment ? m_pSource->head_segment : m_pSource;
+	VDFFVideoSource* head = f->video_source;
+	if (!f->next_segment || !head) {
+		return;
+	}
+	// check once per second
+	if (now - head->m_lastIdleCheck < 1000) {
+		return;
+	}
+	head->m_lastIdleCheck = now;
+
+	std::vector<std::pair<uint64_t, VDFFVideoSource*>> awake; // by a snapshot of m_lastAccess
+	for (; f; f = f->next_segment) {
+		VDFFVideoSource* v = f->video_source;
+		if (!v || v == this || v->m_deferred || v->m_released) {
+			continue;
+		}
+		const uint64_t access = v->m_lastAccess;
+		// signed, a segment pre-warmed meanwhile is newer than now
+		if (config_segment_idle > 0 && int64_t(now - access) > int64_t(config_segment_idle) * 1000) {
+			v->release();
+		} else {
+			awake.emplace_back(access, v);
+		}
+	}
+
+	// the number of open decoders is limited too, this one included
+	const size_t limit = std::max(config_segment_open, 1) - 1;
+	if (awake.size() > limit) {
+		std::sort(awake.begin(), awake.end());
+		for (size_t i = 0; i < awake.size() - limit; i++) {
+			awake[i].second->release();
+		}
+	}
+}
+
+void VDFFVideoSource::prewarm_next(int64_t start)
+{
+	VDFFInputFile* next = m_pSource->next_segment;
+	if (!next || !next->video_source || next->video_source->m_prewarmed || m_copy_mode) {
+		return;
+	}
+	// about two seconds before the end
+	const AVRational fr = m_pStream->r_frame_rate;
+	const int64_t lead = fr.num > 0 && fr.den > 0 ? 2 * fr.num / fr.den : 50;
+	if (start + lead < m_sample_count) {
+		return;
+	}
+
+	VDFFVideoSource* v1 = next->video_source;
+	v1->m_prewarmed = true;
+	m_pSource->prewarm_segment([v1] { v1->prewarm(); });
+}
+
+// decodes the first GOP, so the host finds it in the cache when playback crosses the segment boundary
+void VDFFVideoSource::prewarm()
+{
+	// the host repeats a failed attempt and gets the error
+	if (!init_deferred()) {
+		return;
+	}
+	std::lock_guard lock(m_mutex);
+	m_lastAccess = GetTickCount64();
+
+	if (m_copy_mode || is_image_list || frame_array[0] || !wake()) {
+		return;
+	}
+
+	const int count = std::min({ std::max(keyframe_gap, 1), std::max(buffer_reserve / 2, 1), m_sample_count });
+	for (int i = 0; i < count; i++) {
+		if (frame_array[i]) {
+			continue;
+		}
+		uint8_t dummy;
+		uint32_t bytes, samples;
+		if (!read_sample(i, &dummy, 1, &bytes, &samples, true)) {
+			break;
+		}
+	}
+	DLog(L"VDFFVideoSource: pre-warmed {} frames of {}", count, m_pSource->m_path);
+}
+
+void VDFFVideoSource::grow()
+{
+	std::lock_guard lock(m_mutex);
+
+	if (is_image_list || avi_drop_index || m_pSource->get_end_pts(m_streamIndex) == AV_NOPTS_VALUE) {
+		return;
+	}
+	const int old_count = m_sample_count;
+	const AVRational fr = { (int)m_streamInfo.mInfo.mSampleRate.mNumerator, (int)m_streamInfo.mInfo.mSampleRate.mDenominator };
+	init_duration(fr);
+	if (m_sample_count <= old_count) {
+		m_sample_count = old_count;
+		return;
+	}
+
+	// decoded frames stay in the cache
+	frame_array.resize(m_sample_count);
+	frame_type.resize(m_sample_count, ' ');
+	m_streamInfo.mInfo.mSampleCount = m_sample_count;
+
+	if (trust_index) {
+		// the index covers the old length, new frames are found by their timestamps
+		trust_index  = false;
+		sparse_index = index_count() > 1;
+	}
+
+	// the demuxer may have stopped at the old end, the next read seeks
+	VDFFIOBackend::update_size(m_pFormatCtx->pb);
+	next_frame = -1;
+	last_seek_frame = -1;
+	dead_range_start = -1;
+	dead_range_end = -1;
+
+	DLog(L"VDFFVideoSource: grown from {} to {} frames", old_count, m_sample_count);
+}
+
 void VDFFVideoSource::free_buffers()
 {
 	for (size_t i = 0; i < buffer.size(); i++) {
@@ -2392,6 +2976,7 @@ void VDFFVideoSource::alloc_page(const int pos)
 	r->target = pos;
 	r->refs++;
 	used_frames++;
+	m_perf.cache_bytes_peak = std::max(m_perf.cache_bytes_peak, int64_t(used_frames) * frame_size);
 	frame_array[pos] = r;
 	if (pos > last_frame) last_frame = pos;
 	if (pos < first_frame) first_frame = pos;
@@ -2478,3 +3063,27 @@ void VDFFVideoSource::open_page(BufferPage* p, const int flag)
 		}
 	}
 }
+
+//////////////////////////////////////////////////////////////////////////
+//Performance counters
+//////////////////////////////////////////////////////////////////////////
+
+void VDFFVideoSource::GetPerfCounters(VDFFPerfCounters& counters)
+{
+	m_perf.decoded = decoded_count - m_decodedReset;
+	PerfCountersFromTicks(counters, m_perf);
+}
+
+void VDFFVideoSource::ResetPerfCounters()
+{
+	// decoded_count is shown by the info dialog and keeps counting
+	m_perf = {};
+	m_decodedReset = decoded_count;
+}
+
+int VDFFVideoSource::GetPerfCountersJson(char* buf, int buf_size)
+{
+	VDFFPerfCounters counters;
+	GetPerfCounters(counters);
+	return CopyJson(PerfCountersToJson(counters), buf, buf_size);
+}
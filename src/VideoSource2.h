@@ -10,6 +10,9 @@
 #include <vd2/plugin/vdinputdriver.h>
 #include <vd2/VDXFrame/Unknown.h>
 #include <vector>
+#include <mutex>
+#include <atomic>
+#include "PerfCounters.h"
 
 extern "C"
 {
@@ -27,7 +30,8 @@ class VDFFVideoSource : public vdxunknown<IVDXStreamSource>,
 	public IVDXVideoSource,
 	public IVDXVideoDecoder,
 	public IVDXVideoDecoderModel,
-	public IFilterModVideoDecoder
+	public IFilterModVideoDecoder,
+	public IVDFFPerfCounters
 {
 public:
 	VDFFVideoSource(const VDXInputDriverContext& context);
@@ -88,6 +92,11 @@ public:
 	const void* VDXAPIENTRY GetFrameBufferBase() override;
 	bool        VDXAPIENTRY IsDecodable(int64_t sample_num) override;
 
+	//Performance counters
+	void VDXAPIENTRY GetPerfCounters(VDFFPerfCounters& counters) override;
+	void VDXAPIENTRY ResetPerfCounters() override;
+	int  VDXAPIENTRY GetPerfCountersJson(char* buf, int buf_size) override;
+
 private:
 	//Internal
 	const VDXInputDriverContext& mContext;
@@ -191,19 +200,56 @@ private:
 
 	AVPacket* copy_pkt = nullptr;
 
+	const AVCodec* m_pDecoder = nullptr;
+	// GetTickCount64() of the last Read, pre-warming sets it on another thread
+	std::atomic<uint64_t> m_lastAccess = 0;
+	uint64_t m_lastIdleCheck = 0; // head segment only
+	bool m_released    = false;   // decoder and frame cache are released until the next Read
+	bool m_releasedMem = false;
+	std::atomic<bool> m_prewarmed = false; // the start of the segment was decoded ahead of playback
+	int  m_growth      = 0;       // the last growth of the file handled by grow()
+	// serializes the host with the pre-warming thread and with grow()
+	std::mutex m_mutex;
+	// appended segment whose stream is not opened yet, see init_deferred
+	std::atomic<bool> m_deferred = false;
+	std::mutex m_initMutex;
+	// index of a segment whose demuxer was closed by release(), used instead of the stream index from then on
+	struct IndexEntry {
+		int64_t timestamp;
+		int     flags;
+	};
+	std::vector<IndexEntry> m_index;
+
+	VDFFPerfCounters m_perf; // times in ticks
+	int m_decodedReset = 0;  // decoded_count at the last ResetPerfCounters
+
 	//uint64 kPixFormat_XRGB64;
 
 public:
 	int  initStream(VDFFInputFile* pSource, const int indexStream);
+	// appended segment, only the frame count is taken from the header or the tail scan
+	int  initSegment(VDFFInputFile* pSource, const int indexStream);
+	// runs initStream of a segment on first access, the frame count stays as reported to the host
+	bool init_deferred();
+	bool is_deferred() const { return m_deferred; }
+	// opens the demuxer again if release() has closed it, m_pStream is valid after that
+	bool open_demuxer();
 private:
+	// r_frame_rate, corrected for interlaced streams
+	AVRational get_frame_rate();
 	int  init_duration(const AVRational fr);
+	void fit_sample_count(const int count);
 	void init_format();
 	void set_pixmap_layout(const uint8_t* p);
 	int  handle_frame_num(const int64_t pts, const int64_t dts);
 	int  handle_frame();
+	void store_frame(const int pos);
 	bool check_frame_format();
 	void set_start_time();
 	bool read_frame(const int64_t desired_frame, bool init = false);
+	// Read() within this segment, prewarm = true when called by the pre-warming thread
+	bool read_sample(int64_t start, void* lpBuffer, uint32_t cbBuffer, uint32_t* lBytesRead, uint32_t* lSamplesRead, bool prewarm);
+	bool read_image_sequence(const int frame);
 	void alloc_page(const int pos);
 	BufferPage* remove_page(const int play_pos, const bool before = true, const bool after = true);
 	void dealloc_page(BufferPage* p);
@@ -217,6 +263,22 @@ private:
 	void setDecodeMode(const bool v);
 	void setCacheMode(const bool v);
 	bool is_intra();
+	// the appended segment holding pos (>= m_sample_count), pos becomes local to it
+	VDFFVideoSource* find_segment(int64_t& pos);
+	void release();
+	bool wake();
+	bool reopen_demuxer();
+	int  index_count();
+	int64_t index_timestamp(const int i);
+	bool index_key(const int i);
+	// like av_index_search_timestamp with AVSEEK_FLAG_BACKWARD
+	int  index_search(const int64_t ts);
+	void release_idle_segments();
+	// starts pre-warming of the next segment when playback is near the end of this one
+	void prewarm_next(int64_t start);
+	void prewarm();
+	// extends the frame index after the file has grown
+	void grow();
 	bool allow_copy();
 	bool possible_delay();
 	int  calc_sparse_key(const int64_t sample, int64_t& pos);
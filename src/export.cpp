@@ -18,6 +18,8 @@
 #include "Helper.h"
 #include "ffmpeg_helper.h"
 #include "iobuffer.h"
+#include "IOBackend.h"
+#include "FilePool.h"
 #include "Utils/StringUtil.h"
 
 extern HINSTANCE hInstance;
@@ -294,7 +296,6 @@ bool VDXAPIENTRY VDFFInputFile::ExecuteExport(int id, VDXHWND parent, IProjectSt
 		const wchar_t* ext1 = GetFileExt(path2);
 		bool same_format = wcscmp(ext0, ext1) == 0;
 
-		std::string ff_path = ConvertWideToUtf8(m_path);
 		std::string out_ff_path = ConvertWideToUtf8(path2);
 
 		const AVOutputFormat* oformat = av_guess_format(nullptr, out_ff_path.c_str(), nullptr);
@@ -320,7 +321,7 @@ bool VDXAPIENTRY VDFFInputFile::ExecuteExport(int id, VDXHWND parent, IProjectSt
 		AVStream* out_audio = nullptr;
 
 		int err = 0;
-		err = avformat_open_input(&fmt, ff_path.c_str(), nullptr, nullptr);
+		err = VDFFIOBackend::open_input(&fmt, m_path);
 		if (err < 0) {
 			goto end;
 		}
@@ -504,7 +505,7 @@ bool VDXAPIENTRY VDFFInputFile::ExecuteExport(int id, VDXHWND parent, IProjectSt
 		av_write_trailer(ofmt);
 
 	end:
-		avformat_close_input(&fmt);
+		VDFFFilePool::close_input(&fmt);
 		if (ofmt && !(ofmt->oformat->flags & AVFMT_NOFILE)) {
 			avio_closep(&ofmt->pb);
 		}
@@ -18,6 +18,15 @@ struct IOBuffer {
 		memcpy(this->data, data, size);
 	}
 
+	// uninitialized buffer to be filled by the caller, data is nullptr and size 0 if it cannot be allocated
+	IOBuffer(const int size) {
+		this->data = (uint8_t*)av_malloc(size + AVPROBE_PADDING_SIZE);
+		if (this->data) {
+			this->size = size;
+			memset(this->data + size, 0, AVPROBE_PADDING_SIZE);
+		}
+	}
+
 	~IOBuffer() {
 		av_free(data);
 	}
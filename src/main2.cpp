@@ -11,6 +11,7 @@
 #include <vd2/VDXFrame/VideoFilterDialog.h>
 #include "InputFile2.h"
 #include "export.h"
+#include "ProbeCache.h"
 #include "AudioEncoder/AudioEnc.h"
 #include "resource.h"
 #include "Helper.h"
@@ -21,6 +22,21 @@ bool config_decode_magic = false;
 bool config_force_thread = false;
 bool config_disable_cache = false;
 float config_cache_size = 0.5;
+int config_image_threads = 0;
+int config_image_io_threads = 4;
+int config_image_io_depth = 16;
+int config_audio_read_ahead = 1000;
+float config_audio_cache_size = 1.0;
+bool config_shared_demux = true;
+bool config_audio_predecode = false;
+int config_segment_idle = 30;
+int config_segment_open = 16;
+int config_io_mode = 0;
+int config_io_cache_size = 256; // MB
+int config_growing_check = 0; // seconds between checks for data appended to an open file, 0 - disabled
+#ifdef AVLIB_BENCH
+int config_io_latency = 0; // ms added to every file read, benchmarks only
+#endif
 void saveConfig();
 
 class ConfigureDialog : public VDXVideoFilterDialog {
@@ -199,6 +215,18 @@ extern "C" VDPluginInfo * *__cdecl VDGetPluginInfo()
 	return kPlugins;
 }
 
+#ifdef AVLIB_BENCH
+// called by the benchmark after loading the plugin, io_mode < 0 keeps the option,
+// only the build made by avlib_bench.vcxproj has it
+extern "C" __declspec(dllexport) void __cdecl VDFFBenchConfigure(int io_mode, int io_latency)
+{
+	if (io_mode >= 0) {
+		config_io_mode = std::clamp(io_mode, 0, 5);
+	}
+	config_io_latency = std::clamp(io_latency, 0, 10000);
+}
+#endif
+
 void saveConfig()
 {
 	wchar_t buf[MAX_PATH + 128];
@@ -224,6 +252,29 @@ void saveConfig()
 	auto str = std::format(L"{:.2}", config_cache_size);
 	WritePrivateProfileStringW(L"decode_model", L"cache_size", str.c_str(), buf);
 
+	str = std::to_wstring(config_image_threads);
+	WritePrivateProfileStringW(L"decode_model", L"image_threads", str.c_str(), buf);
+	str = std::to_wstring(config_image_io_threads);
+	WritePrivateProfileStringW(L"decode_model", L"image_io_threads", str.c_str(), buf);
+	str = std::to_wstring(config_image_io_depth);
+	WritePrivateProfileStringW(L"decode_model", L"image_io_depth", str.c_str(), buf);
+	str = std::to_wstring(config_audio_read_ahead);
+	WritePrivateProfileStringW(L"decode_model", L"audio_read_ahead", str.c_str(), buf);
+	str = std::format(L"{:.2}", config_audio_cache_size);
+	WritePrivateProfileStringW(L"decode_model", L"audio_cache_size", str.c_str(), buf);
+	WritePrivateProfileStringW(L"decode_model", L"shared_demux", config_shared_demux ? L"1" : L"0", buf);
+	WritePrivateProfileStringW(L"decode_model", L"audio_predecode", config_audio_predecode ? L"1" : L"0", buf);
+	str = std::to_wstring(config_segment_idle);
+	WritePrivateProfileStringW(L"decode_model", L"segment_idle", str.c_str(), buf);
+	str = std::to_wstring(config_segment_open);
+	WritePrivateProfileStringW(L"decode_model", L"segment_open", str.c_str(), buf);
+	str = std::to_wstring(config_io_mode);
+	WritePrivateProfileStringW(L"decode_model", L"io_mode", str.c_str(), buf);
+	str = std::to_wstring(config_io_cache_size);
+	WritePrivateProfileStringW(L"decode_model", L"io_cache_size", str.c_str(), buf);
+	str = std::to_wstring(config_growing_check);
+	WritePrivateProfileStringW(L"decode_model", L"growing_check", str.c_str(), buf);
+
 	WritePrivateProfileStringW(0, 0, 0, buf);
 }
 
@@ -258,6 +309,25 @@ void loadConfig()
 		config_cache_size = 0.5;
 	}
 
+	config_image_threads = GetPrivateProfileIntW(L"decode_model", L"image_threads", 0, buf);
+	config_image_io_threads = std::clamp(GetPrivateProfileIntW(L"decode_model", L"image_io_threads", 4, buf), 0, 64);
+	config_image_io_depth = std::clamp(GetPrivateProfileIntW(L"decode_model", L"image_io_depth", 16, buf), 0, 1024);
+	config_audio_read_ahead = std::clamp(GetPrivateProfileIntW(L"decode_model", L"audio_read_ahead", 1000, buf), 0, 30000);
+
+	GetPrivateProfileStringW(L"decode_model", L"audio_cache_size", L"1.0", buf2, 128, buf);
+	if (swscanf_s(buf2, L"%f", &v2) == 1 && v2 > 0) {
+		config_audio_cache_size = v2;
+	} else {
+		config_audio_cache_size = 1.0;
+	}
+	config_shared_demux = GetPrivateProfileIntW(L"decode_model", L"shared_demux", 1, buf) != 0;
+	config_audio_predecode = GetPrivateProfileIntW(L"decode_model", L"audio_predecode", 0, buf) != 0;
+	config_segment_idle = std::clamp(GetPrivateProfileIntW(L"decode_model", L"segment_idle", 30, buf), 0, 3600);
+	config_segment_open = std::clamp(GetPrivateProfileIntW(L"decode_model", L"segment_open", 16, buf), 1, 1024);
+	config_io_mode = std::clamp(GetPrivateProfileIntW(L"decode_model", L"io_mode", 0, buf), 0, 5);
+	config_io_cache_size = std::clamp(GetPrivateProfileIntW(L"decode_model", L"io_cache_size", 256, buf), 16, 4096);
+	config_growing_check = std::clamp(GetPrivateProfileIntW(L"decode_model", L"growing_check", 0, buf), 0, 60);
+
 	ff_plugin_video.mpStaticConfigureProc = 0;
 
 	ff_plugin_image = ff_plugin_video;
@@ -360,6 +430,10 @@ BOOLEAN WINAPI DllMain(IN HINSTANCE hDllHandle, IN DWORD nReason, IN LPVOID Rese
 		return true;
 
 	case DLL_PROCESS_DETACH:
+		// on process exit the other threads are already gone
+		if (!Reserved) {
+			VDFFProbeCache::Shutdown();
+		}
 		return true;
 	}
 
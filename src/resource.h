@@ -137,6 +137,7 @@
 #define IDC_ENC_JOINT_STEREO            1098
 #define IDC_ENC_CBR                     1099
 #define IDC_ENC_ABR                     1100
+#define IDC_COPY_STATS                  1101
 
 #define IDC_STATIC                      -1
 
@@ -146,7 +147,7 @@
 #ifndef APSTUDIO_READONLY_SYMBOLS
 #define _APS_NEXT_RESOURCE_VALUE        122
 #define _APS_NEXT_COMMAND_VALUE         40001
-#define _APS_NEXT_CONTROL_VALUE         1065
+#define _APS_NEXT_CONTROL_VALUE         1102
 #define _APS_NEXT_SYMED_VALUE           101
 #endif
 #endif
@@ -0,0 +1,372 @@
+/*
+ * Copyright (C) 2026 v0lt
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+// Unit tests of the parts of the plugin that do not need the host or FFmpeg.
+// Returns 0 if all checks pass.
+
+#include <algorithm>
+#include <cfloat>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "../src/AudioBufferPage.h"
+#include "../src/Utils/ContainerSignature.h"
+#include "../src/Utils/ImageList.h"
+#include "../src/Utils/Interleave.h"
+#include "../src/Utils/PeakReduce.h"
+#include "../src/Utils/SegmentTable.h"
+
+static int g_failed = 0;
+
+#define CHECK(expr) \
+	do { \
+		if (!(expr)) { \
+			printf("%s(%d): failed: %s\n", __FILE__, __LINE__, #expr); \
+			g_failed++; \
+		} \
+	} while (0)
+
+static bool has_ranges(const AudioBufferPage& bp, std::vector<AudioBufferPage::Range> expected)
+{
+	if (bp.ranges.size() != expected.size()) {
+		return false;
+	}
+	for (size_t i = 0; i < expected.size(); i++) {
+		if (bp.ranges[i].s0 != expected[i].s0 || bp.ranges[i].s1 != expected[i].s1) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static void test_alloc_merge()
+{
+	AudioBufferPage bp;
+	int changed = 0;
+
+	CHECK(bp.alloc(100, 100, changed) == 100);
+	CHECK(changed == 1);
+	CHECK(has_ranges(bp, { { 100, 200 } }));
+
+	// already cached
+	CHECK(bp.alloc(120, 50, changed) == 50);
+	CHECK(changed == 0);
+
+	// overlap with the tail
+	bp.alloc(150, 100, changed);
+	CHECK(changed == 1);
+	CHECK(has_ranges(bp, { { 100, 250 } }));
+
+	// adjacent in front
+	bp.alloc(50, 50, changed);
+	CHECK(has_ranges(bp, { { 50, 250 } }));
+
+	// adjacent behind
+	bp.alloc(250, 10, changed);
+	CHECK(has_ranges(bp, { { 50, 260 } }));
+
+	// clamped to the end of the page
+	CHECK(bp.alloc(AudioBufferPage::size - 10, 100, changed) == 10);
+	CHECK(has_ranges(bp, { { 50, 260 }, { AudioBufferPage::size - 10, AudioBufferPage::size } }));
+}
+
+static void test_alloc_fragments()
+{
+	AudioBufferPage bp;
+	int changed = 0;
+
+	bp.alloc(1000, 100, changed);
+	bp.alloc(0, 100, changed);
+	CHECK(has_ranges(bp, { { 0, 100 }, { 1000, 1100 } }));
+
+	// third fragment between the others
+	bp.alloc(500, 100, changed);
+	CHECK(has_ranges(bp, { { 0, 100 }, { 500, 600 }, { 1000, 1100 } }));
+	CHECK(bp.find(0) == 0);
+	CHECK(bp.find(100) == 1);
+	CHECK(bp.find(700) == 2);
+	CHECK(bp.find(1100) == 3);
+
+	// bridges all three
+	bp.alloc(50, 1000, changed);
+	CHECK(changed == 1);
+	CHECK(has_ranges(bp, { { 0, 1100 } }));
+}
+
+static void test_erase()
+{
+	AudioBufferPage bp;
+	int changed = 0;
+
+	bp.alloc(0, 1000, changed);
+
+	// split the range
+	bp.erase(400, 600);
+	CHECK(has_ranges(bp, { { 0, 400 }, { 600, 1000 } }));
+
+	// trim both ranges
+	bp.erase(300, 700);
+	CHECK(has_ranges(bp, { { 0, 300 }, { 700, 1000 } }));
+
+	// remove a whole range
+	bp.erase(600, 1200);
+	CHECK(has_ranges(bp, { { 0, 300 } }));
+
+	// outside of any range
+	bp.erase(500, 600);
+	CHECK(has_ranges(bp, { { 0, 300 } }));
+}
+
+static void test_copy_empty()
+{
+	const int sample_size = 2;
+	std::vector<uint8_t> data(AudioBufferPage::size * sample_size);
+	for (size_t i = 0; i < data.size(); i++) {
+		data[i] = (uint8_t)i;
+	}
+
+	AudioBufferPage bp;
+	bp.aud_data = data.data();
+	int changed = 0;
+	bp.alloc(100, 100, changed);
+	bp.alloc(300, 100, changed);
+
+	uint8_t dst[1000 * sample_size] = {};
+
+	// stops at the gap
+	CHECK(bp.copy(150, 500, dst, sample_size) == 50);
+	CHECK(memcmp(dst, data.data() + 150 * sample_size, 50 * sample_size) == 0);
+	CHECK(bp.copy(150, 20, dst, sample_size) == 20);
+
+	// nothing in the gap
+	CHECK(bp.copy(200, 10, dst, sample_size) == 0);
+	CHECK(bp.copy(0, 10, dst, sample_size) == 0);
+
+	CHECK(bp.empty(150, 10) == 0);
+	CHECK(bp.empty(200, 500) == 100);
+	CHECK(bp.empty(200, 50) == 50);
+	CHECK(bp.empty(400, 100000) == AudioBufferPage::size - 400);
+}
+
+static void test_image_list_name()
+{
+	ImageListName name;
+	const std::wstring_view path = L"C:\\clip\\frame0012.png";
+	CHECK(ParseImageListName(path, path.rfind(L'.'), name));
+	CHECK(name.name0 == 8);
+	CHECK(name.digit0 == 13);
+	CHECK(name.width == 4);
+	CHECK(name.start == 12);
+
+	// digits of the directory do not count
+	const std::wstring_view dir = L"C:\\clip2\\frame.png";
+	CHECK(!ParseImageListName(dir, dir.rfind(L'.'), name));
+	const std::wstring_view wide = L"frame1234567890.png";
+	CHECK(!ParseImageListName(wide, wide.rfind(L'.'), name));
+
+	CHECK(ParseImageListNumber(L"0012", 4) == 12);
+	CHECK(ParseImageListNumber(L"12345", 4) == 12345);
+	// not printed by %04d
+	CHECK(ParseImageListNumber(L"012", 4) == -1);
+	CHECK(ParseImageListNumber(L"00123", 4) == -1);
+	CHECK(ParseImageListNumber(L"00a2", 4) == -1);
+}
+
+static void test_image_list_gaps()
+{
+	// a missing file repeats the previous one
+	CHECK(MapImageList({ 14, 10, 11, 13 }, 10, 1000) == std::vector<int>({ 10, 11, 11, 13, 14 }));
+	// numbers before the first file are not used
+	CHECK(MapImageList({ 5, 10, 11 }, 10, 1000) == std::vector<int>({ 10, 11 }));
+	// the first file itself is not listed
+	CHECK(MapImageList({ 12 }, 10, 1000) == std::vector<int>({ 10, 10, 12 }));
+	// a large gap starts a different sequence
+	CHECK(MapImageList({ 1, 2, 5, 100 }, 1, 3) == std::vector<int>({ 1, 2, 2, 2, 5 }));
+	CHECK(MapImageList({}, 7, 1000) == std::vector<int>({ 7 }));
+}
+
+// compares with a plain loop, count is chosen to leave a tail after the SSE2 steps
+template <typename T>
+static bool check_interleave(int channels, int count)
+{
+	std::vector<std::vector<T>> planes(channels, std::vector<T>(count));
+	std::vector<const uint8_t*> src(channels);
+	for (int c = 0; c < channels; c++) {
+		for (int i = 0; i < count; i++) {
+			planes[c][i] = T(c * 1000 + i + 1);
+		}
+		src[c] = (const uint8_t*)planes[c].data();
+	}
+
+	std::vector<T> dst(count * channels);
+	if (!InterleaveSamples((uint8_t*)dst.data(), src.data(), channels, count, sizeof(T))) {
+		return false;
+	}
+	for (int i = 0; i < count; i++) {
+		for (int c = 0; c < channels; c++) {
+			if (dst[i * channels + c] != planes[c][i]) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+static void test_interleave()
+{
+	// 2 and 4 channels use SSE2, the others the scalar loop
+	for (int channels = 1; channels <= 8; channels++) {
+		CHECK(check_interleave<uint16_t>(channels, 37));
+		CHECK(check_interleave<uint32_t>(channels, 37));
+		// only the scalar tail
+		CHECK(check_interleave<uint16_t>(channels, 3));
+		CHECK(check_interleave<uint32_t>(channels, 3));
+	}
+
+	uint32_t dst[4];
+	const uint8_t* src[9] = {};
+	CHECK(!InterleaveSamples((uint8_t*)dst, src, 9, 0, 4));
+	CHECK(!InterleaveSamples((uint8_t*)dst, src, 2, 0, 8));
+}
+
+static const char* container_of(std::vector<uint8_t> header)
+{
+	header.resize(std::max<size_t>(header.size(), 64));
+	return FindContainerSignature(header.data(), (int32_t)header.size());
+}
+
+static bool is_container(const char* name, const char* expected)
+{
+	return name && strcmp(name, expected) == 0;
+}
+
+static void test_container_signature()
+{
+	CHECK(is_container(container_of({ 0x1A, 0x45, 0xDF, 0xA3, 0x9F, 0x42, 0x82, 0x88, 'm', 'a', 't', 'r', 'o', 's', 'k', 'a' }), "matroska,webm"));
+	CHECK(is_container(container_of({ 0x1A, 0x45, 0xDF, 0xA3, 0x9F, 0x42, 0x82, 0x84, 'w', 'e', 'b', 'm' }), "matroska,webm"));
+	// EBML of another document type
+	CHECK(!container_of({ 0x1A, 0x45, 0xDF, 0xA3, 0x9F, 0x42, 0x82, 0x84, 'a', 'b', 'c', 'd' }));
+
+	CHECK(is_container(container_of({ 'F', 'L', 'V', 1, 5, 0, 0, 0, 9 }), "flv"));
+	CHECK(!container_of({ 'F', 'L', 'V', 1, 5, 0, 0, 0, 5 }));
+	CHECK(is_container(container_of({ 'O', 'g', 'g', 'S', 0 }), "ogg"));
+	CHECK(!container_of({ 'O', 'g', 'g', 'S', 1 }));
+	CHECK(is_container(container_of({ 'Y', 'U', 'V', '4', 'M', 'P', 'E', 'G', '2', ' ' }), "yuv4mpegpipe"));
+	const char nut[] = "nut/multimedia container";
+	CHECK(is_container(container_of(std::vector<uint8_t>(nut, nut + sizeof(nut))), "nut"));
+	CHECK(is_container(container_of({ 0x06, 0x0E, 0x2B, 0x34, 0x02, 0x05, 0x01, 0x01, 0x0D, 0x01, 0x02, 0x01, 0x01, 0x02 }), "mxf"));
+
+	// the sync byte of every packet
+	for (const int ts_size : { 188, 192 }) {
+		std::vector<uint8_t> ts(ts_size * 6);
+		for (int i = 0; i < 6; i++) {
+			ts[ts_size - 188 + i * ts_size] = 0x47;
+		}
+		CHECK(is_container(container_of(ts), "mpegts"));
+		ts[ts_size - 188 + 3 * ts_size] = 0;
+		CHECK(!container_of(ts));
+	}
+
+	// too short to tell
+	const uint8_t flv[] = { 'F', 'L', 'V', 1, 5, 0, 0, 0, 9 };
+	CHECK(!FindContainerSignature(flv, sizeof(flv)));
+	CHECK(!FindContainerSignature(nullptr, 64));
+}
+
+static void test_find_segment()
+{
+	int a = 0, b = 0, c = 0;
+	const std::vector<int*> sources = { &a, &b, &c };
+	const std::vector<int64_t> starts = { 0, 100, 250 };
+
+	int64_t pos = 0;
+	CHECK(FindSegment(sources, starts, pos) == &a && pos == 0);
+	pos = 99;
+	CHECK(FindSegment(sources, starts, pos) == &a && pos == 99);
+	pos = 100;
+	CHECK(FindSegment(sources, starts, pos) == &b && pos == 0);
+	pos = 249;
+	CHECK(FindSegment(sources, starts, pos) == &b && pos == 149);
+	pos = 250;
+	CHECK(FindSegment(sources, starts, pos) == &c && pos == 0);
+	// after the end
+	pos = 1000;
+	CHECK(FindSegment(sources, starts, pos) == &c && pos == 750);
+
+	// one segment
+	pos = 5;
+	CHECK(FindSegment(std::vector<int*>{ &a }, std::vector<int64_t>{ 0 }, pos) == &a && pos == 5);
+	pos = 5;
+	CHECK(FindSegment(std::vector<int*>{}, std::vector<int64_t>{}, pos) == nullptr && pos == 5);
+}
+
+// compares with a plain loop over the same samples
+static bool check_peak_reduce(int channels, int count)
+{
+	std::vector<float> data(count * channels);
+	for (size_t i = 0; i < data.size(); i++) {
+		data[i] = float((int(i * 7919) % 2001) - 1000) / 1000.0f;
+	}
+
+	std::vector<float> vmin(channels, FLT_MAX), vmax(channels, -FLT_MAX);
+	std::vector<double> sumsq(channels, 0);
+	ReducePeakSamples(data.data(), count, channels, vmin.data(), vmax.data(), sumsq.data());
+
+	for (int c = 0; c < channels; c++) {
+		float mn = FLT_MAX, mx = -FLT_MAX;
+		double sq = 0;
+		for (int i = 0; i < count; i++) {
+			const float v = data[i * channels + c];
+			mn = std::min(mn, v);
+			mx = std::max(mx, v);
+			sq += v * v;
+		}
+		// the SSE path sums in float
+		if (vmin[c] != mn || vmax[c] != mx || sq - sumsq[c] > sq * 1e-5 || sumsq[c] - sq > sq * 1e-5) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static void test_peak_reduce()
+{
+	// 1, 2 and 4 channels use SSE, the others the scalar loop
+	for (int channels = 1; channels <= 8; channels++) {
+		CHECK(check_peak_reduce(channels, 1001));
+		CHECK(check_peak_reduce(channels, 1));
+	}
+
+	// adds to the previous values
+	float vmin[2] = { -2, 0 }, vmax[2] = { 0, 2 };
+	double sumsq[2] = { 1, 1 };
+	const float data[4] = { 0.5f, -0.5f, 0.25f, -0.25f };
+	ReducePeakSamples(data, 2, 2, vmin, vmax, sumsq);
+	CHECK(vmin[0] == -2 && vmax[0] == 0.5f && vmin[1] == -0.5f && vmax[1] == 2);
+	CHECK(sumsq[0] == 1.3125 && sumsq[1] == 1.3125);
+}
+
+int main()
+{
+	test_alloc_merge();
+	test_alloc_fragments();
+	test_erase();
+	test_copy_empty();
+	test_image_list_name();
+	test_image_list_gaps();
+	test_interleave();
+	test_peak_reduce();
+	test_container_signature();
+	test_find_segment();
+
+	if (g_failed) {
+		printf("%d checks failed\n", g_failed);
+		return 1;
+	}
+	printf("all tests passed\n");
+	return 0;
+}